@@ -0,0 +1,99 @@
+//
+// file BindingCache.cc
+// agent
+// 18th October 2026
+//
+
+#include "BindingCache.H"
+#include "DACOEMolAtomIndex.H"
+#include "TautGraph.H"
+
+#include <oechem.h>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+// ****************************************************************************
+BindingCache::BindingCache( BindingBits &bits , OEMolBase &mol ,
+                            const TautGraph &graph , vector<pOESubSearch> &searches ) :
+  bits_( bits ) , mol_( mol ) , graph_( graph ) , searches_( searches ) {
+
+  if( bits_.known_.size() != searches_.size() ) {
+    bits_.known_ = vector<boost::dynamic_bitset<> >( searches_.size() ,
+                                                     boost::dynamic_bitset<>( graph_.num_atoms() ) );
+    bits_.value_ = bits_.known_;
+  }
+
+}
+
+// ****************************************************************************
+// a search rooted at the atom, which only needs to find 1 match.
+bool BindingCache::matches( unsigned int binding , unsigned int atom ) const {
+
+  if( bits_.known_[binding][atom] ) {
+    return bits_.value_[binding][atom];
+  }
+
+  bool ret_val = false;
+  if( searches_[binding] ) {
+    OESubSearch &subs = *searches_[binding];
+    OEIter<OEQAtomBase> patt_atom = subs.GetPattern().GetQAtoms();
+    subs.ClearConstraints();
+    subs.AddConstraint( OEMatchPairAtom( patt_atom , graph_.atom( atom ) ) );
+    ret_val = subs.SingleMatch( mol_ );
+    subs.ClearConstraints();
+  }
+
+  bits_.known_[binding][atom] = true;
+  bits_.value_[binding][atom] = ret_val;
+
+  return ret_val;
+
+}
+
+// ****************************************************************************
+void BindingCache::tag_atoms( OEMolBase &mol , vector<int> &prev_idx ) {
+
+  prev_idx.clear();
+  vector<OEAtomBase *> atoms;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    atoms.push_back( atom );
+    if( atom->HasData( DACLIB::ATOM_INDEX_TAG ) ) {
+      prev_idx.push_back( static_cast<int>( atom->GetData<unsigned int>( DACLIB::ATOM_INDEX_TAG ) ) );
+    } else {
+      prev_idx.push_back( -1 );
+    }
+  }
+
+  for( size_t i = 0 , is = atoms.size() ; i < is ; ++i ) {
+    DACLIB::set_atom_index( *atoms[i] , static_cast<unsigned int>( i ) );
+  }
+
+}
+
+// ****************************************************************************
+void BindingCache::inherit( const BindingBits &parent_bits , const vector<int> &prev_idx ,
+                            const vector<int> &edit_dists , const vector<int> &radii ) {
+
+  if( bits_.known_.empty() || parent_bits.known_.size() != bits_.known_.size() ) {
+    return;
+  }
+
+  for( unsigned int i = 0 , is = graph_.num_atoms() ; i < is ; ++i ) {
+    int pi = i < prev_idx.size() ? prev_idx[i] : -1;
+    if( pi < 0 || pi >= static_cast<int>( parent_bits.known_.front().size() ) ) {
+      continue;
+    }
+    int dist = edit_dists[graph_.atom( i )->GetIdx()];
+    for( size_t j = 0 , js = bits_.known_.size() ; j < js ; ++j ) {
+      // -1 for either means the parent's answer can't be trusted
+      if( radii[j] < 0 || dist < 0 || dist <= radii[j] ) {
+        continue;
+      }
+      bits_.known_[j][i] = parent_bits.known_[j][pi];
+      bits_.value_[j][i] = parent_bits.value_[j][pi];
+    }
+  }
+
+}
@@ -0,0 +1,778 @@
+//
+// file CompiledTautRule.cc
+// agent
+// 18th October 2026
+//
+
+#include "CompiledTautRule.H"
+#include "BindingCache.H"
+#include "SmartsGraph.H"
+#include "TautGraph.H"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+
+#include <boost/foreach.hpp>
+
+#include <oechem.h>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+size_t find_closing( const string &smarts , size_t start ); // in smarts_radius.cc
+}
+
+// ****************************************************************************
+// The atom expression of a pattern atom, as a tree of logical operators with
+// the primitives at the leaves.
+class TautAtomExpr {
+
+public :
+
+  enum Type { AND , OR , NOT , ANY , AROMATIC , ALIPHATIC , ATOMIC_NUM ,
+              H_COUNT , CONNECTIVITY , DEGREE , CHARGE , BINDING };
+
+  TautAtomExpr( Type type , int value = 0 ) : type_( type ) , value_( value ) {}
+
+  Type type_;
+  int value_;
+  vector<boost::shared_ptr<TautAtomExpr> > kids_;
+
+  bool matches( const TautGraph &graph , const BindingCache &bindings ,
+                unsigned int i ) const;
+  // true if the expression can only match aliphatic atoms
+  bool aliphatic_only() const;
+
+};
+
+typedef boost::shared_ptr<TautAtomExpr> pTautAtomExpr;
+
+// ****************************************************************************
+bool TautAtomExpr::matches( const TautGraph &graph , const BindingCache &bindings ,
+                            unsigned int i ) const {
+
+  switch( type_ ) {
+  case AND :
+    BOOST_FOREACH( pTautAtomExpr kid , kids_ ) {
+      if( !kid->matches( graph , bindings , i ) ) {
+        return false;
+      }
+    }
+    return true;
+  case OR :
+    BOOST_FOREACH( pTautAtomExpr kid , kids_ ) {
+      if( kid->matches( graph , bindings , i ) ) {
+        return true;
+      }
+    }
+    return false;
+  case NOT :
+    return !kids_.front()->matches( graph , bindings , i );
+  case ANY :
+    return true;
+  case AROMATIC :
+    return graph.aromatic( i );
+  case ALIPHATIC :
+    return !graph.aromatic( i );
+  case ATOMIC_NUM :
+    return static_cast<int>( graph.atomic_num( i ) ) == value_;
+  case H_COUNT :
+    return static_cast<int>( graph.total_h_count( i ) ) == value_;
+  case CONNECTIVITY :
+    return static_cast<int>( graph.connectivity( i ) ) == value_;
+  case DEGREE :
+    return static_cast<int>( graph.degree( i ) ) == value_;
+  case CHARGE :
+    return graph.formal_charge( i ) == value_;
+  case BINDING :
+    return bindings.matches( static_cast<unsigned int>( value_ ) , i );
+  }
+
+  return false;
+
+}
+
+// ****************************************************************************
+bool TautAtomExpr::aliphatic_only() const {
+
+  switch( type_ ) {
+  case AND :
+    BOOST_FOREACH( pTautAtomExpr kid , kids_ ) {
+      if( kid->aliphatic_only() ) {
+        return true;
+      }
+    }
+    return false;
+  case OR :
+    BOOST_FOREACH( pTautAtomExpr kid , kids_ ) {
+      if( !kid->aliphatic_only() ) {
+        return false;
+      }
+    }
+    return !kids_.empty();
+  case ALIPHATIC :
+    return true;
+  default :
+    return false;
+  }
+
+}
+
+namespace {
+
+// ****************************************************************************
+unsigned int read_number( const string &expr , size_t &pos , unsigned int def_val ) {
+
+  if( pos >= expr.length() || !isdigit( expr[pos] ) ) {
+    return def_val;
+  }
+  unsigned int ret_val = 0;
+  while( pos < expr.length() && isdigit( expr[pos] ) ) {
+    ret_val = 10 * ret_val + static_cast<unsigned int>( expr[pos] - '0' );
+    ++pos;
+  }
+  return ret_val;
+
+}
+
+// ****************************************************************************
+pTautAtomExpr element_expr( int atomic_num , bool aromatic ) {
+
+  pTautAtomExpr ret_val( new TautAtomExpr( TautAtomExpr::AND ) );
+  ret_val->kids_.push_back( pTautAtomExpr( new TautAtomExpr( TautAtomExpr::ATOMIC_NUM , atomic_num ) ) );
+  ret_val->kids_.push_back( pTautAtomExpr( new TautAtomExpr( aromatic ? TautAtomExpr::AROMATIC : TautAtomExpr::ALIPHATIC ) ) );
+  return ret_val;
+
+}
+
+// ****************************************************************************
+// atomic number of the element symbol at pos, which is moved past it, or 0 if
+// it's not one that's catered for.
+int element_symbol( const string &expr , size_t &pos , bool &aromatic ) {
+
+  static const char *symbols[] = { "Cl" , "Br" , "Si" , "Se" , "B" , "C" , "N" ,
+                                   "O" , "P" , "S" , "F" , "I" ,
+                                   "b" , "c" , "n" , "o" , "p" , "s" , 0 };
+  static const int atomic_nums[] = { 17 , 35 , 14 , 34 , 5 , 6 , 7 , 8 , 15 , 16 ,
+                                     9 , 53 , 5 , 6 , 7 , 8 , 15 , 16 };
+
+  for( int i = 0 ; symbols[i] ; ++i ) {
+    string sym( symbols[i] );
+    if( 0 == expr.compare( pos , sym.length() , sym ) ) {
+      size_t end = pos + sym.length();
+      // a following lower-case letter means it's a symbol we don't know
+      // about, such as Na, or something ambiguous like cs.
+      if( end < expr.length() && islower( expr[end] ) ) {
+        return 0;
+      }
+      aromatic = islower( sym[0] );
+      pos = end;
+      return atomic_nums[i];
+    }
+  }
+
+  return 0;
+
+}
+
+// ****************************************************************************
+pTautAtomExpr parse_primitive( const string &expr , size_t &pos ,
+                               const vector<pair<string,string> > &vbs ,
+                               vector<string> &inline_recs ) {
+
+  if( pos >= expr.length() ) {
+    return pTautAtomExpr();
+  }
+
+  char c = expr[pos];
+  bool next_lower = pos + 1 < expr.length() && islower( expr[pos+1] );
+  switch( c ) {
+  case '*' :
+    ++pos;
+    return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::ANY ) );
+  case '#' :
+    ++pos;
+    if( pos >= expr.length() || !isdigit( expr[pos] ) ) {
+      return pTautAtomExpr();
+    }
+    return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::ATOMIC_NUM , read_number( expr , pos , 0 ) ) );
+  case 'H' :
+    if( next_lower ) {
+      return pTautAtomExpr(); // Hg, Ho etc.
+    }
+    ++pos;
+    return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::H_COUNT , read_number( expr , pos , 1 ) ) );
+  case 'X' :
+    ++pos;
+    return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::CONNECTIVITY , read_number( expr , pos , 1 ) ) );
+  case 'D' :
+    ++pos;
+    return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::DEGREE , read_number( expr , pos , 1 ) ) );
+  case '+' : case '-' : {
+    ++pos;
+    int charge = 1;
+    if( pos < expr.length() && isdigit( expr[pos] ) ) {
+      charge = read_number( expr , pos , 1 );
+    } else {
+      while( pos < expr.length() && c == expr[pos] ) {
+        ++charge;
+        ++pos;
+      }
+    }
+    return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::CHARGE , '+' == c ? charge : -charge ) );
+  }
+  case 'a' : case 'A' :
+    if( next_lower ) {
+      return pTautAtomExpr(); // as, Al etc.
+    }
+    ++pos;
+    return pTautAtomExpr( new TautAtomExpr( 'a' == c ? TautAtomExpr::AROMATIC : TautAtomExpr::ALIPHATIC ) );
+  case '$' : {
+    // a vector binding by name, or an in-line recursive SMARTS, both of which
+    // are looked up in a BindingCache. The in-line ones come after the vector
+    // bindings in its list.
+    if( pos + 1 < expr.length() && '(' == expr[pos+1] ) {
+      size_t end = DACLIB::find_closing( expr , pos + 1 );
+      if( string::npos == end ) {
+        return pTautAtomExpr();
+      }
+      string rec_smarts = expr.substr( pos + 2 , end - pos - 2 );
+      pos = end + 1;
+      vector<string>::iterator p = find( inline_recs.begin() , inline_recs.end() , rec_smarts );
+      int rec_num = static_cast<int>( p - inline_recs.begin() );
+      if( inline_recs.end() == p ) {
+        inline_recs.push_back( rec_smarts );
+      }
+      return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::BINDING ,
+                                              static_cast<int>( vbs.size() ) + rec_num ) );
+    }
+    size_t end = pos + 1;
+    while( end < expr.length() && ( isalnum( expr[end] ) || '_' == expr[end] ) ) {
+      ++end;
+    }
+    string name = expr.substr( pos + 1 , end - pos - 1 );
+    for( size_t i = 0 , is = vbs.size() ; i < is ; ++i ) {
+      if( vbs[i].first == name ) {
+        pos = end;
+        return pTautAtomExpr( new TautAtomExpr( TautAtomExpr::BINDING , static_cast<int>( i ) ) );
+      }
+    }
+    return pTautAtomExpr();
+  }
+  default : {
+    bool aromatic = false;
+    int atomic_num = element_symbol( expr , pos , aromatic );
+    if( atomic_num ) {
+      return element_expr( atomic_num , aromatic );
+    }
+    // ring primitives, recursive SMARTS, chirality, isotopes etc.
+    return pTautAtomExpr();
+  }
+  }
+
+}
+
+pTautAtomExpr parse_low_and( const string &expr , size_t &pos ,
+                             const vector<pair<string,string> > &vbs ,
+                             vector<string> &inline_recs );
+
+// ****************************************************************************
+pTautAtomExpr parse_not( const string &expr , size_t &pos ,
+                         const vector<pair<string,string> > &vbs ,
+                         vector<string> &inline_recs ) {
+
+  if( pos < expr.length() && '!' == expr[pos] ) {
+    ++pos;
+    pTautAtomExpr kid = parse_not( expr , pos , vbs , inline_recs );
+    if( !kid ) {
+      return kid;
+    }
+    pTautAtomExpr ret_val( new TautAtomExpr( TautAtomExpr::NOT ) );
+    ret_val->kids_.push_back( kid );
+    return ret_val;
+  }
+
+  return parse_primitive( expr , pos , vbs , inline_recs );
+
+}
+
+// ****************************************************************************
+// & and implicit and, which bind more tightly than ,
+pTautAtomExpr parse_high_and( const string &expr , size_t &pos ,
+                              const vector<pair<string,string> > &vbs ,
+                              vector<string> &inline_recs ) {
+
+  pTautAtomExpr ret_val( new TautAtomExpr( TautAtomExpr::AND ) );
+  while( pos < expr.length() && ',' != expr[pos] && ';' != expr[pos] ) {
+    if( '&' == expr[pos] ) {
+      ++pos;
+      continue;
+    }
+    pTautAtomExpr kid = parse_not( expr , pos , vbs , inline_recs );
+    if( !kid ) {
+      return kid;
+    }
+    ret_val->kids_.push_back( kid );
+  }
+
+  if( ret_val->kids_.empty() ) {
+    return pTautAtomExpr();
+  }
+  return 1 == ret_val->kids_.size() ? ret_val->kids_.front() : ret_val;
+
+}
+
+// ****************************************************************************
+pTautAtomExpr parse_or( const string &expr , size_t &pos ,
+                        const vector<pair<string,string> > &vbs ,
+                        vector<string> &inline_recs ) {
+
+  pTautAtomExpr ret_val( new TautAtomExpr( TautAtomExpr::OR ) );
+  while( true ) {
+    pTautAtomExpr kid = parse_high_and( expr , pos , vbs , inline_recs );
+    if( !kid ) {
+      return kid;
+    }
+    ret_val->kids_.push_back( kid );
+    if( pos < expr.length() && ',' == expr[pos] ) {
+      ++pos;
+    } else {
+      break;
+    }
+  }
+
+  return 1 == ret_val->kids_.size() ? ret_val->kids_.front() : ret_val;
+
+}
+
+// ****************************************************************************
+// ; - the lowest precedence operator
+pTautAtomExpr parse_low_and( const string &expr , size_t &pos ,
+                             const vector<pair<string,string> > &vbs ,
+                             vector<string> &inline_recs ) {
+
+  pTautAtomExpr ret_val( new TautAtomExpr( TautAtomExpr::AND ) );
+  while( true ) {
+    pTautAtomExpr kid = parse_or( expr , pos , vbs , inline_recs );
+    if( !kid ) {
+      return kid;
+    }
+    ret_val->kids_.push_back( kid );
+    if( pos < expr.length() && ';' == expr[pos] ) {
+      ++pos;
+    } else {
+      break;
+    }
+  }
+
+  return 1 == ret_val->kids_.size() ? ret_val->kids_.front() : ret_val;
+
+}
+
+// ****************************************************************************
+pTautAtomExpr parse_atom_expr( const string &expr ,
+                               const vector<pair<string,string> > &vbs ,
+                               vector<string> &inline_recs ) {
+
+  size_t pos = 0;
+  pTautAtomExpr ret_val = parse_low_and( expr , pos , vbs , inline_recs );
+  if( pos != expr.length() ) {
+    return pTautAtomExpr();
+  }
+  return ret_val;
+
+}
+
+// ****************************************************************************
+bool is_hydrogen_expr( const string &expr ) {
+
+  return "H" == expr || "#1" == expr;
+
+}
+
+// ****************************************************************************
+// the product side of the SMIRKS can only re-state the atom or give its
+// element, otherwise OELibraryGen might be changing charges or
+// hydrogen counts on the atoms and that's not something done here.
+bool product_expr_ok( const string &reac_expr , const string &prod_expr ) {
+
+  if( "*" == prod_expr || ( is_hydrogen_expr( reac_expr ) && prod_expr == reac_expr ) ) {
+    return true;
+  }
+  if( prod_expr == reac_expr ) {
+    return string::npos == prod_expr.find_first_of( "H+-" );
+  }
+  size_t pos = 0;
+  bool aromatic = false;
+  return element_symbol( prod_expr , pos , aromatic ) && pos == prod_expr.length();
+
+}
+
+// ****************************************************************************
+// only the bond symbols that OELibraryGen will set an order from. Implicit
+// bonds in the product are single.
+unsigned int product_bond_order( char bond ) {
+
+  switch( bond ) {
+  case ' ' : case '-' :
+    return 1;
+  case '=' :
+    return 2;
+  case '#' :
+    return 3;
+  default :
+    return 0;
+  }
+
+}
+
+// ****************************************************************************
+bool bond_matches( char bond , unsigned int order , bool aromatic ) {
+
+  switch( bond ) {
+  case '-' :
+    return 1 == order && !aromatic;
+  case '=' :
+    return 2 == order && !aromatic;
+  case '#' :
+    return 3 == order;
+  case ':' :
+    return aromatic;
+  case '~' :
+    return true;
+  case ' ' :
+    return ( 1 == order && !aromatic ) || aromatic;
+  default :
+    return false;
+  }
+
+}
+
+// ****************************************************************************
+// heavy atom bonds keyed on the map indices of the two ends, and the heavy atom
+// each hydrogen is attached to keyed on the hydrogen's map index. Returns
+// false if a hydrogen doesn't have exactly 1 bond.
+bool pattern_bonds( const vector<DACLIB::SmartsAtom> &atoms ,
+                    const vector<DACLIB::SmartsBond> &bonds ,
+                    map<pair<unsigned int,unsigned int>,char> &heavy_bonds ,
+                    map<unsigned int,unsigned int> &h_attach ) {
+
+  BOOST_FOREACH( const DACLIB::SmartsBond &bond , bonds ) {
+    const DACLIB::SmartsAtom &a = atoms[bond.a_];
+    const DACLIB::SmartsAtom &b = atoms[bond.b_];
+    bool a_is_h = is_hydrogen_expr( a.expr_ );
+    bool b_is_h = is_hydrogen_expr( b.expr_ );
+    if( a_is_h && b_is_h ) {
+      return false;
+    } else if( a_is_h || b_is_h ) {
+      unsigned int h_map = a_is_h ? a.map_ : b.map_;
+      unsigned int heavy_map = a_is_h ? b.map_ : a.map_;
+      if( !h_attach.insert( make_pair( h_map , heavy_map ) ).second ) {
+        return false;
+      }
+    } else {
+      heavy_bonds.insert( make_pair( make_pair( min( a.map_ , b.map_ ) , max( a.map_ , b.map_ ) ) ,
+                                     bond.bond_ ) );
+    }
+  }
+
+  return true;
+
+}
+
+} // EO anon namespace
+
+// ****************************************************************************
+CompiledTautRule::CompiledTautRule( const string &smirks ,
+                                    const vector<pair<string,string> > &vbs ,
+                                    vector<string> &inline_recs ) :
+  compiled_( false ) {
+
+  // if it doesn't compile, any in-line recursive SMARTS it added are just
+  // surplus to requirements.
+  compile( smirks , vbs , inline_recs );
+  if( !compiled_ ) {
+    atoms_.clear();
+    ring_bonds_.clear();
+    bond_changes_.clear();
+    h_moves_.clear();
+  }
+
+}
+
+// ****************************************************************************
+void CompiledTautRule::match( const TautGraph &graph , const BindingCache &bindings ,
+                              vector<vector<unsigned int> > &matches ) const {
+
+  matches.clear();
+  if( !compiled_ ) {
+    return;
+  }
+
+  vector<unsigned int> curr_match( atoms_.size() , 0 );
+  vector<char> used( graph.num_atoms() , 0 );
+  for( unsigned int i = 0 , is = graph.num_atoms() ; i < is ; ++i ) {
+    if( !atoms_.front().test_->matches( graph , bindings , i ) ) {
+      continue;
+    }
+    curr_match[0] = i;
+    used[i] = 1;
+    extend_match( graph , bindings , 1 , curr_match , used , matches );
+    used[i] = 0;
+  }
+
+}
+
+// ****************************************************************************
+OEMolBase *CompiledTautRule::apply( const OEMolBase &start_mol ,
+                                    const vector<unsigned int> &match ,
+                                    vector<OEAtomBase *> *prod_match ) const {
+
+  OEMolBase *prod = OENewMolBase( start_mol , OEMolBaseType::OEDefault );
+
+  // a copy keeps the atom order, which is what the TautGraph indices are
+  vector<OEAtomBase *> prod_atoms;
+  for( OEIter<OEAtomBase> atom = prod->GetAtoms() ; atom ; ++atom ) {
+    prod_atoms.push_back( atom );
+  }
+
+  BOOST_FOREACH( const BondChange &bc , bond_changes_ ) {
+    OEBondBase *bond = prod->GetBond( prod_atoms[match[bc.a_]] ,
+                                      prod_atoms[match[bc.b_]] );
+    bond->SetOrder( bc.order_ );
+  }
+  BOOST_FOREACH( const HMove &hm , h_moves_ ) {
+    OEAtomBase *h = prod_atoms[match[hm.h_]];
+    prod->DeleteBond( prod->GetBond( h , prod_atoms[match[hm.from_]] ) );
+    prod->NewBond( h , prod_atoms[match[hm.to_]] , 1 );
+  }
+
+  for( size_t i = 0 , is = atoms_.size() ; i < is ; ++i ) {
+    prod_atoms[match[i]]->SetMapIdx( atoms_[i].map_ );
+  }
+  if( prod_match ) {
+    prod_match->clear();
+    BOOST_FOREACH( unsigned int m , match ) {
+      prod_match->push_back( prod_atoms[m] );
+    }
+  }
+
+  return prod;
+
+}
+
+// ****************************************************************************
+void CompiledTautRule::edits( const vector<unsigned int> &match ,
+                              vector<pair<unsigned int,unsigned int> > &h_moves ,
+                              vector<pair<pair<unsigned int,unsigned int>,unsigned int> > &bond_changes ) const {
+
+  h_moves.clear();
+  bond_changes.clear();
+  BOOST_FOREACH( const HMove &hm , h_moves_ ) {
+    h_moves.push_back( make_pair( match[hm.from_] , match[hm.to_] ) );
+  }
+  BOOST_FOREACH( const BondChange &bc , bond_changes_ ) {
+    bond_changes.push_back( make_pair( make_pair( match[bc.a_] , match[bc.b_] ) , bc.order_ ) );
+  }
+
+}
+
+// ****************************************************************************
+// leaves compiled_ false if there's anything in the SMIRKS that can't be
+// done natively.
+void CompiledTautRule::compile( const string &smirks ,
+                                const vector<pair<string,string> > &vbs ,
+                                vector<string> &inline_recs ) {
+
+  size_t arrow = smirks.find( ">>" );
+  if( string::npos == arrow || string::npos != smirks.find( '>' , arrow + 2 ) ) {
+    return;
+  }
+  vector<DACLIB::SmartsAtom> r_atoms , p_atoms;
+  vector<DACLIB::SmartsBond> r_bonds , p_bonds;
+  if( !DACLIB::parse_smarts_graph( smirks.substr( 0 , arrow ) , r_atoms , r_bonds ) ||
+      !DACLIB::parse_smarts_graph( smirks.substr( arrow + 2 ) , p_atoms , p_bonds ) ||
+      r_atoms.size() != p_atoms.size() ) {
+    return;
+  }
+
+  // every atom must be mapped, exactly once on each side
+  map<unsigned int,size_t> p_of_map , r_of_map;
+  for( size_t i = 0 , is = p_atoms.size() ; i < is ; ++i ) {
+    if( !p_atoms[i].map_ || !p_of_map.insert( make_pair( p_atoms[i].map_ , i ) ).second ) {
+      return;
+    }
+  }
+  for( size_t i = 0 , is = r_atoms.size() ; i < is ; ++i ) {
+    if( !r_atoms[i].map_ || !r_of_map.insert( make_pair( r_atoms[i].map_ , i ) ).second ||
+        p_of_map.end() == p_of_map.find( r_atoms[i].map_ ) ) {
+      return;
+    }
+  }
+
+  atoms_.resize( r_atoms.size() );
+  for( size_t i = 0 , is = r_atoms.size() ; i < is ; ++i ) {
+    const DACLIB::SmartsAtom &p_atom = p_atoms[p_of_map[r_atoms[i].map_]];
+    if( is_hydrogen_expr( r_atoms[i].expr_ ) != is_hydrogen_expr( p_atom.expr_ ) ||
+        !product_expr_ok( r_atoms[i].expr_ , p_atom.expr_ ) ) {
+      return;
+    }
+    atoms_[i].map_ = r_atoms[i].map_;
+    // [H] on its own is a hydrogen atom, not an atom with 1 hydrogen
+    if( is_hydrogen_expr( r_atoms[i].expr_ ) ) {
+      atoms_[i].test_ = pTautAtomExpr( new TautAtomExpr( TautAtomExpr::ATOMIC_NUM , 1 ) );
+    } else {
+      atoms_[i].test_ = parse_atom_expr( r_atoms[i].expr_ , vbs , inline_recs );
+    }
+    if( !atoms_[i].test_ ) {
+      return;
+    }
+    atoms_[i].parent_ = -1;
+    atoms_[i].parent_bond_ = ' ';
+  }
+
+  // the order the pattern is matched in is the order it was written
+  BOOST_FOREACH( const DACLIB::SmartsBond &bond , r_bonds ) {
+    if( bond.ring_closure_ ) {
+      RingBond rb;
+      rb.a_ = bond.a_;
+      rb.b_ = bond.b_;
+      rb.bond_ = bond.bond_;
+      ring_bonds_.push_back( rb );
+    } else {
+      atoms_[bond.b_].parent_ = static_cast<int>( bond.a_ );
+      atoms_[bond.b_].parent_bond_ = bond.bond_;
+    }
+  }
+  for( size_t i = 1 , is = atoms_.size() ; i < is ; ++i ) {
+    if( -1 == atoms_[i].parent_ ) {
+      return;
+    }
+  }
+
+  // the same pairs of heavy atoms must be bonded on both sides, so the only
+  // thing that changes is bond orders
+  map<pair<unsigned int,unsigned int>,char> r_heavy_bonds , p_heavy_bonds;
+  map<unsigned int,unsigned int> r_h_attach , p_h_attach;
+  if( !pattern_bonds( r_atoms , r_bonds , r_heavy_bonds , r_h_attach ) ||
+      !pattern_bonds( p_atoms , p_bonds , p_heavy_bonds , p_h_attach ) ||
+      r_heavy_bonds.size() != p_heavy_bonds.size() ) {
+    return;
+  }
+
+  typedef pair<pair<unsigned int,unsigned int>,char> MAP_BOND;
+  BOOST_FOREACH( const MAP_BOND &rb , r_heavy_bonds ) {
+    map<pair<unsigned int,unsigned int>,char>::iterator pb = p_heavy_bonds.find( rb.first );
+    if( p_heavy_bonds.end() == pb ) {
+      return;
+    }
+    if( rb.second == pb->second ) {
+      continue;
+    }
+    size_t a = r_of_map[rb.first.first] , b = r_of_map[rb.first.second];
+    // changing aromatic bonds means re-doing the Kekule structure, which
+    // OELibraryGen is trusted to do.
+    BondChange bc;
+    bc.a_ = a;
+    bc.b_ = b;
+    bc.order_ = product_bond_order( pb->second );
+    if( !bc.order_ || !product_bond_order( rb.second ) ||
+        !atoms_[a].test_->aliphatic_only() || !atoms_[b].test_->aliphatic_only() ) {
+      return;
+    }
+    bond_changes_.push_back( bc );
+  }
+
+  for( size_t i = 0 , is = r_atoms.size() ; i < is ; ++i ) {
+    if( !is_hydrogen_expr( r_atoms[i].expr_ ) ) {
+      continue;
+    }
+    map<unsigned int,unsigned int>::iterator r_h = r_h_attach.find( atoms_[i].map_ );
+    map<unsigned int,unsigned int>::iterator p_h = p_h_attach.find( atoms_[i].map_ );
+    if( r_h_attach.end() == r_h || p_h_attach.end() == p_h ) {
+      return;
+    }
+    if( r_h->second == p_h->second ) {
+      continue;
+    }
+    HMove hm;
+    hm.h_ = i;
+    hm.from_ = r_of_map[r_h->second];
+    hm.to_ = r_of_map[p_h->second];
+    if( !atoms_[hm.from_].test_->aliphatic_only() ||
+        !atoms_[hm.to_].test_->aliphatic_only() ) {
+      return;
+    }
+    h_moves_.push_back( hm );
+  }
+
+  if( bond_changes_.empty() && h_moves_.empty() ) {
+    return;
+  }
+
+  compiled_ = true;
+
+}
+
+// ****************************************************************************
+// atoms 0 to k - 1 are in curr_match, try all ways of adding atom k.
+void CompiledTautRule::extend_match( const TautGraph &graph ,
+                                     const BindingCache &bindings , unsigned int k ,
+                                     vector<unsigned int> &curr_match ,
+                                     vector<char> &used ,
+                                     vector<vector<unsigned int> > &matches ) const {
+
+  if( k == atoms_.size() ) {
+    matches.push_back( curr_match );
+    return;
+  }
+
+  const PattAtom &patt_atom = atoms_[k];
+  unsigned int par = curr_match[patt_atom.parent_];
+  for( unsigned int j = graph.nbr_begin( par ) , js = graph.nbr_end( par ) ; j < js ; ++j ) {
+    unsigned int nbr = graph.nbr( j );
+    if( used[nbr] ||
+        !bond_matches( patt_atom.parent_bond_ , graph.bond_order( j ) , graph.bond_aromatic( j ) ) ||
+        !patt_atom.test_->matches( graph , bindings , nbr ) ) {
+      continue;
+    }
+    curr_match[k] = nbr;
+    if( !ring_bonds_match( graph , k , curr_match ) ) {
+      continue;
+    }
+    used[nbr] = 1;
+    extend_match( graph , bindings , k + 1 , curr_match , used , matches );
+    used[nbr] = 0;
+  }
+
+}
+
+// ****************************************************************************
+// check the ring closures that finish at atom k
+bool CompiledTautRule::ring_bonds_match( const TautGraph &graph , unsigned int k ,
+                                         const vector<unsigned int> &curr_match ) const {
+
+  BOOST_FOREACH( const RingBond &rb , ring_bonds_ ) {
+    if( rb.b_ != k ) {
+      continue;
+    }
+    unsigned int at = curr_match[k] , other = curr_match[rb.a_];
+    bool found = false;
+    for( unsigned int j = graph.nbr_begin( at ) , js = graph.nbr_end( at ) ; j < js ; ++j ) {
+      if( graph.nbr( j ) == other ) {
+        found = bond_matches( rb.bond_ , graph.bond_order( j ) , graph.bond_aromatic( j ) );
+        break;
+      }
+    }
+    if( !found ) {
+      return false;
+    }
+  }
+
+  return true;
+
+}
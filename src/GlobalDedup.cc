@@ -0,0 +1,233 @@
+//
+// file GlobalDedup.cc
+// agent
+// 18th October 2026
+//
+
+#include "GlobalDedup.H"
+#include "FileExceptions.H"
+
+#include <algorithm>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+namespace DACLIB {
+void hash_smiles_128( const string &smiles , boost::uint64_t &hi ,
+                      boost::uint64_t &lo ); // in eponymous file
+}
+
+// an unordered_set node and its share of the buckets, roughly
+static const size_t BYTES_PER_KEY = 48;
+
+// min() takes them by reference
+const size_t GlobalDedup::FENCE_STRIDE;
+const size_t GlobalDedup::SPILL_BLOCK;
+
+// ****************************************************************************
+GlobalDedup::GlobalDedup( const string &mapping_file , unsigned int max_memory_mb ,
+                          const string &spill_dir ) :
+  spill_dir_( spill_dir ) {
+
+  size_t max_shard_keys = size_t( max_memory_mb ) * 1024 * 1024 / ( BYTES_PER_KEY * NUM_SHARDS );
+  if( max_shard_keys < FENCE_STRIDE ) {
+    max_shard_keys = FENCE_STRIDE;
+  }
+  if( spill_dir_.empty() ) {
+    spill_dir_ = boost::filesystem::temp_directory_path().string();
+  }
+  for( unsigned int i = 0 ; i < NUM_SHARDS ; ++i ) {
+    shards_[i].max_keys_ = max_shard_keys;
+    shards_[i].spill_.num_keys_ = 0;
+    shards_[i].num_unique_ = shards_[i].num_dups_ = shards_[i].num_spills_ = 0;
+  }
+
+  map_os_.open( mapping_file.c_str() );
+  if( !map_os_ || !map_os_.good() ) {
+    throw DACLIB::FileWriteOpenError( mapping_file.c_str() );
+  }
+
+}
+
+// ****************************************************************************
+GlobalDedup::~GlobalDedup() {
+
+  for( unsigned int i = 0 ; i < NUM_SHARDS ; ++i ) {
+    if( shards_[i].spill_.fs_ ) {
+      shards_[i].spill_.fs_.reset();
+      boost::system::error_code ec;
+      boost::filesystem::remove( shards_[i].spill_.filename_ , ec );
+    }
+  }
+
+}
+
+// ****************************************************************************
+bool GlobalDedup::add( const string &smiles , const string &title ) {
+
+  Key key = make_key( smiles );
+  Shard &shard = shards_[key.hi_ % NUM_SHARDS];
+
+  bool is_new = false;
+  {
+    boost::mutex::scoped_lock lock( shard.mutex_ );
+    if( shard.keys_.find( key ) == shard.keys_.end() && !in_spill_file( shard , key ) ) {
+      shard.keys_.insert( key );
+      ++shard.num_unique_;
+      is_new = true;
+      if( shard.keys_.size() >= shard.max_keys_ ) {
+        spill( shard );
+      }
+    } else {
+      ++shard.num_dups_;
+    }
+  }
+
+  boost::mutex::scoped_lock lock( map_mutex_ );
+  map_os_ << smiles << " " << title << " " << ( is_new ? 1 : 0 ) << '\n';
+
+  return is_new;
+
+}
+
+// ****************************************************************************
+void GlobalDedup::report( ostream &os ) const {
+
+  unsigned long num_unique = 0 , num_dups = 0 , num_spills = 0 , num_files = 0;
+  for( unsigned int i = 0 ; i < NUM_SHARDS ; ++i ) {
+    num_unique += shards_[i].num_unique_;
+    num_dups += shards_[i].num_dups_;
+    num_spills += shards_[i].num_spills_;
+    if( shards_[i].spill_.fs_ ) {
+      ++num_files;
+    }
+  }
+  os << "Global dedup : " << num_unique << " distinct molecules written, "
+     << num_dups << " duplicates dropped, " << num_spills << " spills into "
+     << num_files << " spill files." << endl;
+
+}
+
+// ****************************************************************************
+GlobalDedup::Key GlobalDedup::make_key( const string &smiles ) {
+
+  Key key;
+  DACLIB::hash_smiles_128( smiles , key.hi_ , key.lo_ );
+  return key;
+
+}
+
+// ****************************************************************************
+bool GlobalDedup::in_spill_file( Shard &shard , const Key &key ) const {
+
+  const SpillFile &sf = shard.spill_;
+  if( !sf.fs_ ) {
+    return false;
+  }
+  // the block that key would be in, if it's there
+  vector<Key>::const_iterator f = upper_bound( sf.fence_.begin() , sf.fence_.end() , key );
+  if( f == sf.fence_.begin() ) {
+    return false;
+  }
+  size_t start = size_t( f - sf.fence_.begin() - 1 ) * FENCE_STRIDE;
+  size_t len = min( FENCE_STRIDE , sf.num_keys_ - start );
+  vector<Key> block( len );
+  sf.fs_->seekg( streamoff( start * sizeof( Key ) ) );
+  sf.fs_->read( reinterpret_cast<char *>( &block[0] ) , streamsize( len * sizeof( Key ) ) );
+
+  return binary_search( block.begin() , block.end() , key );
+
+}
+
+// ****************************************************************************
+// The keys in memory are merged with those already in the shard's spill file
+// into a new one, which replaces it. That re-writes everything spilled so far
+// each time, but there's a lookup for every molecule offered and only one
+// spill for every max_keys_ new ones, and the lookup only ever has one file
+// to search, rather than one per spill.
+void GlobalDedup::spill( Shard &shard ) {
+
+  vector<Key> keys( shard.keys_.begin() , shard.keys_.end() );
+  sort( keys.begin() , keys.end() );
+
+  SpillFile new_file;
+  if( !open_spill_file( new_file ) ) {
+    // keep going in memory, rather than give up half way through a long run
+    cerr << "Couldn't open dedup spill file " << new_file.filename_ << " so keeping everything in memory." << endl;
+    shard.max_keys_ *= 2;
+    return;
+  }
+
+  SpillFile &old_file = shard.spill_;
+  vector<Key> old_keys , out_keys;
+  size_t next_old = 0 , old_read = 0 , next_new = 0;
+  new_file.num_keys_ = 0;
+  if( old_file.fs_ ) {
+    old_file.fs_->seekg( 0 );
+  }
+  while( true ) {
+    // the next block of the old file, when the last one's used up
+    if( next_old == old_keys.size() && old_read < old_file.num_keys_ ) {
+      old_keys.resize( min( SPILL_BLOCK , old_file.num_keys_ - old_read ) );
+      old_file.fs_->read( reinterpret_cast<char *>( &old_keys[0] ) ,
+                          streamsize( old_keys.size() * sizeof( Key ) ) );
+      old_read += old_keys.size();
+      next_old = 0;
+    }
+    bool old_left = next_old < old_keys.size();
+    bool new_left = next_new < keys.size();
+    if( !old_left && !new_left ) {
+      break;
+    }
+    // they can't be in both
+    if( old_left && ( !new_left || old_keys[next_old] < keys[next_new] ) ) {
+      out_keys.push_back( old_keys[next_old++] );
+    } else {
+      out_keys.push_back( keys[next_new++] );
+    }
+    if( !( new_file.num_keys_ % FENCE_STRIDE ) ) {
+      new_file.fence_.push_back( out_keys.back() );
+    }
+    ++new_file.num_keys_;
+    if( out_keys.size() == SPILL_BLOCK ) {
+      new_file.fs_->write( reinterpret_cast<const char *>( &out_keys[0] ) ,
+                           streamsize( out_keys.size() * sizeof( Key ) ) );
+      out_keys.clear();
+    }
+  }
+  if( !out_keys.empty() ) {
+    new_file.fs_->write( reinterpret_cast<const char *>( &out_keys[0] ) ,
+                         streamsize( out_keys.size() * sizeof( Key ) ) );
+  }
+  new_file.fs_->flush();
+
+  if( old_file.fs_ ) {
+    old_file.fs_.reset();
+    boost::system::error_code ec;
+    boost::filesystem::remove( old_file.filename_ , ec );
+  }
+  shard.spill_ = new_file;
+  ++shard.num_spills_;
+  // clear() keeps the buckets
+  boost::unordered_set<Key,KeyHash>().swap( shard.keys_ );
+
+}
+
+// ****************************************************************************
+bool GlobalDedup::open_spill_file( SpillFile &spill_file ) const {
+
+  spill_file.filename_ = ( boost::filesystem::path( spill_dir_ ) /
+                           boost::filesystem::unique_path( "taut_enum_dedup_%%%%-%%%%-%%%%.spill" ) ).string();
+  spill_file.fs_.reset( new fstream( spill_file.filename_.c_str() ,
+                                     ios::in | ios::out | ios::trunc | ios::binary ) );
+  if( !spill_file.fs_->good() ) {
+    spill_file.fs_.reset();
+    return false;
+  }
+
+  return true;
+
+}
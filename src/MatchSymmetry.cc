@@ -0,0 +1,107 @@
+//
+// file MatchSymmetry.cc
+// agent
+// 18th October 2026
+//
+
+#include "MatchSymmetry.H"
+
+#include <set>
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+bool stereo_specified( const OEMolBase &mol ); // in perceive_tautomer.cc
+}
+
+// ****************************************************************************
+MatchSymmetry::MatchSymmetry( OEMolBase &mol ) :
+  mol_( mol ) , initialised_( false ) , symmetric_( false ) {
+
+}
+
+// ****************************************************************************
+bool MatchSymmetry::seen( unsigned int rule_num , const vector<OEAtomBase *> &match ) {
+
+  if( !initialised_ ) {
+    initialise();
+  }
+  if( !symmetric_ ) {
+    return false;
+  }
+
+  MatchKey key( rule_num , vector<unsigned int>() );
+  BOOST_FOREACH( OEAtomBase *atom , match ) {
+    key.second.push_back( atom->GetSymmetryClass() );
+  }
+
+  vector<vector<OEAtomBase *> > &prev_matches = seen_[key];
+  BOOST_FOREACH( const vector<OEAtomBase *> &prev_match , prev_matches ) {
+    if( equivalent( prev_match , match ) ) {
+      return true;
+    }
+  }
+  prev_matches.push_back( match );
+
+  return false;
+
+}
+
+// ****************************************************************************
+// The symmetry classes are from the aromatic graph, but the self search is
+// on the Kekule structure and the hydrogens are explicit atoms, so it has
+// the last word on whether the products would be the same.
+void MatchSymmetry::initialise() {
+
+  initialised_ = true;
+  if( DACLIB::stereo_specified( mol_ ) ) {
+    return;
+  }
+
+  OEPerceiveSymmetry( mol_ );
+  set<unsigned int> classes;
+  for( OEIter<OEAtomBase> atom = mol_.GetAtoms() ; atom ; ++atom ) {
+    classes.insert( atom->GetSymmetryClass() );
+  }
+  if( classes.size() == mol_.NumAtoms() ) {
+    return;
+  }
+
+  self_search_.reset( new OESubSearch( mol_ , OEExprOpts::AtomicNumber | OEExprOpts::FormalCharge ,
+                                       OEExprOpts::BondOrder ) );
+  if( !*self_search_ || self_search_->GetPattern().NumAtoms() != mol_.NumAtoms() ) {
+    self_search_.reset();
+    return;
+  }
+  // the pattern's atoms come out in the order of mol_'s
+  patt_atoms_ = vector<OEQAtomBase *>( mol_.GetMaxAtomIdx() , static_cast<OEQAtomBase *>( 0 ) );
+  OEIter<OEAtomBase> atom = mol_.GetAtoms();
+  for( OEIter<OEQAtomBase> patt_atom = self_search_->GetPattern().GetQAtoms() ;
+       patt_atom && atom ; ++patt_atom , ++atom ) {
+    patt_atoms_[atom->GetIdx()] = patt_atom;
+  }
+
+  symmetric_ = true;
+
+}
+
+// ****************************************************************************
+bool MatchSymmetry::equivalent( const vector<OEAtomBase *> &match1 ,
+                                const vector<OEAtomBase *> &match2 ) {
+
+  self_search_->ClearConstraints();
+  for( size_t i = 0 , is = match1.size() ; i < is ; ++i ) {
+    self_search_->AddConstraint( OEMatchPairAtom( patt_atoms_[match1[i]->GetIdx()] , match2[i] ) );
+  }
+  bool ret_val = self_search_->SingleMatch( mol_ );
+  self_search_->ClearConstraints();
+
+  return ret_val;
+
+}
@@ -0,0 +1,60 @@
+//
+// file PassthroughScreen.cc
+// agent
+// 18th October 2026
+//
+
+#include "PassthroughScreen.H"
+#include "SMARTSExceptions.H"
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+using namespace OEChem;
+
+namespace DACLIB {
+OESubSearch *create_oesubsearch( const string &smarts , bool reorder ); // in eponymous file
+string extract_smarts_from_smirks( const string &smirks ); // in eponymous file
+}
+
+// ****************************************************************************
+PassthroughScreen::PassthroughScreen() :
+  bad_smarts_( false ) , num_tested_( 0 ) , num_passed_( 0 ) {
+
+}
+
+// ****************************************************************************
+void PassthroughScreen::add_smirks( const vector<string> &exp_smirks ) {
+
+  BOOST_FOREACH( const string &smirks , exp_smirks ) {
+    string smarts = DACLIB::extract_smarts_from_smirks( smirks );
+    if( !smarts_.insert( smarts ).second ) {
+      continue;
+    }
+    try {
+      screens_.push_back( pOESubSearch( DACLIB::create_oesubsearch( smarts , false ) ) );
+    } catch( DACLIB::SMARTSDefnError &e ) {
+      bad_smarts_ = true;
+    }
+  }
+
+}
+
+// ****************************************************************************
+bool PassthroughScreen::passes( const OEMolBase &mol ) {
+
+  ++num_tested_;
+  if( bad_smarts_ ) {
+    return false;
+  }
+  BOOST_FOREACH( pOESubSearch screen , screens_ ) {
+    if( screen->SingleMatch( mol ) ) {
+      return false;
+    }
+  }
+  ++num_passed_;
+  return true;
+
+}
@@ -0,0 +1,104 @@
+//
+// file ProtonationCache.cc
+// agent
+// 18th October 2026
+//
+
+#include "ProtonationCache.H"
+
+#include <iostream>
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+using namespace OEChem;
+
+// ****************************************************************************
+ProtonationCache::ProtonationCache( size_t max_size ) :
+  max_size_( max_size ) , hits_( 0 ) , misses_( 0 ) , evictions_( 0 ) ,
+  duplicates_( 0 ) {
+
+}
+
+// ****************************************************************************
+bool ProtonationCache::find( const string &smiles , const string &title ,
+                             vector<OEMolBase *> &prot_mols , bool &too_many ) {
+
+  // the molecules are copied after the lock's gone, so the other threads
+  // aren't kept waiting. Holding their pointers keeps them alive if the entry
+  // is dropped in the meantime.
+  vector<pOEMolBase> mols;
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    map<string,list<Entry>::iterator>::iterator p = index_.find( smiles );
+    if( index_.end() == p ) {
+      ++misses_;
+      return false;
+    }
+
+    ++hits_;
+    // move it to the front, as the most recently used
+    entries_.splice( entries_.begin() , entries_ , p->second );
+    const Entry &entry = entries_.front();
+    too_many = entry.too_many_;
+    mols = entry.mols_;
+  }
+  BOOST_FOREACH( pOEMolBase mol , mols ) {
+    prot_mols.push_back( OENewMolBase( *mol , OEMolBaseType::OEDefault ) );
+    prot_mols.back()->SetTitle( title );
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+void ProtonationCache::add( const string &smiles , const vector<OEMolBase *> &prot_mols ,
+                            bool too_many ) {
+
+  if( !max_size_ ) {
+    return;
+  }
+  // likewise, the copies are made before taking the lock
+  Entry entry;
+  entry.smiles_ = smiles;
+  entry.too_many_ = too_many;
+  BOOST_FOREACH( OEMolBase *mol , prot_mols ) {
+    entry.mols_.push_back( pOEMolBase( OENewMolBase( *mol , OEMolBaseType::OEDefault ) ) );
+  }
+
+  boost::mutex::scoped_lock lock( mutex_ );
+  // another thread may have got there first
+  if( index_.end() != index_.find( smiles ) ) {
+    return;
+  }
+  entries_.push_front( entry );
+  index_[smiles] = entries_.begin();
+
+  if( entries_.size() > max_size_ ) {
+    index_.erase( entries_.back().smiles_ );
+    entries_.pop_back();
+    ++evictions_;
+  }
+
+}
+
+// ****************************************************************************
+void ProtonationCache::add_duplicate() {
+
+  boost::mutex::scoped_lock lock( mutex_ );
+  ++duplicates_;
+
+}
+
+// ****************************************************************************
+void ProtonationCache::report( ostream &os ) const {
+
+  os << "Protonation cache : " << hits_ << " hits, " << misses_ << " misses, "
+     << evictions_ << " evictions, " << entries_.size() << " entries at end." << endl
+     << "Tautomers with a protonation state already done for their molecule : "
+     << duplicates_ << endl;
+
+}
@@ -0,0 +1,156 @@
+//
+// file ResultCache.cc
+// agent
+// 18th October 2026
+//
+
+#include "ResultCache.H"
+#include "FileExceptions.H"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <oechem.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+using namespace std;
+using namespace OEChem;
+
+namespace DACLIB {
+void hash_smiles_128( const string &smiles , boost::uint64_t &hi ,
+                      boost::uint64_t &lo ); // in eponymous file
+}
+
+namespace bfs = boost::filesystem;
+
+// ****************************************************************************
+static string hash_hex( const string &str ) {
+
+  boost::uint64_t hi , lo;
+  DACLIB::hash_smiles_128( str , hi , lo );
+  ostringstream oss;
+  oss << hex << setfill( '0' ) << setw( 16 ) << hi << setw( 16 ) << lo;
+  return oss.str();
+
+}
+
+// ****************************************************************************
+string result_cache_smiles( const OEMolBase &mol ) {
+
+  string smi;
+  OECreateSmiString( smi , mol , OESMILESFlag::Canonical | OESMILESFlag::AtomStereo |
+                     OESMILESFlag::BondStereo | OESMILESFlag::Isotopes | OESMILESFlag::RGroups );
+  return smi;
+
+}
+
+// ****************************************************************************
+ResultCache::ResultCache( const string &cache_dir , const string &settings_desc ) :
+  hits_( 0 ) , misses_( 0 ) , adds_( 0 ) {
+
+  bfs::path dir = bfs::path( cache_dir ) / hash_hex( settings_desc );
+  boost::system::error_code ec;
+  bfs::create_directories( dir , ec );
+  if( !bfs::is_directory( dir ) ) {
+    throw DACLIB::FileWriteOpenError( dir.string().c_str() );
+  }
+  dir_ = dir.string();
+
+  // so it's possible to see what a directory is for
+  bfs::path desc_file = dir / "settings.txt";
+  if( !bfs::exists( desc_file ) ) {
+    ofstream ofs( desc_file.string().c_str() );
+    ofs << settings_desc;
+  }
+
+}
+
+// ****************************************************************************
+bool ResultCache::find( const string &in_smi , const string &title ,
+                        vector<OEMolBase *> &out_mols ) {
+
+  ifstream ifs( entry_name( in_smi ).c_str() );
+  string line;
+  if( !ifs || !getline( ifs , line ) || line != in_smi ) {
+    ++misses_;
+    return false;
+  }
+
+  vector<OEMolBase *> these_mols;
+  while( getline( ifs , line ) ) {
+    OEMolBase *mol = OENewMolBase( OEMolBaseType::OEDefault );
+    if( !OEParseSmiles( *mol , line ) ) {
+      delete mol;
+      BOOST_FOREACH( OEMolBase *m , these_mols ) {
+        delete m;
+      }
+      ++misses_;
+      return false;
+    }
+    OEAssignAromaticFlags( *mol );
+    OEPerceiveChiral( *mol );
+    mol->SetTitle( title );
+    these_mols.push_back( mol );
+  }
+  if( these_mols.empty() ) {
+    ++misses_;
+    return false;
+  }
+
+  ++hits_;
+  out_mols.insert( out_mols.end() , these_mols.begin() , these_mols.end() );
+  return true;
+
+}
+
+// ****************************************************************************
+void ResultCache::add( const string &in_smi , const vector<OEMolBase *> &out_mols ) {
+
+  if( out_mols.empty() ) {
+    return;
+  }
+
+  string name = entry_name( in_smi );
+  boost::system::error_code ec;
+  bfs::create_directories( bfs::path( name ).parent_path() , ec );
+  string tmp_name = name + bfs::unique_path( ".%%%%-%%%%-%%%%.tmp" ).string();
+  {
+    ofstream ofs( tmp_name.c_str() );
+    if( !ofs || !ofs.good() ) {
+      return; // it's only a cache
+    }
+    ofs << in_smi << endl;
+    BOOST_FOREACH( OEMolBase *mol , out_mols ) {
+      ofs << result_cache_smiles( *mol ) << endl;
+    }
+    if( !ofs.good() ) {
+      ofs.close();
+      bfs::remove( tmp_name , ec );
+      return;
+    }
+  }
+  // if another job got there first, it'll have written the same thing
+  bfs::rename( tmp_name , name , ec );
+  if( ec ) {
+    bfs::remove( tmp_name , ec );
+  } else {
+    ++adds_;
+  }
+
+}
+
+// ****************************************************************************
+// the entries are spread over 256 subdirectories to keep them to a
+// manageable size.
+string ResultCache::entry_name( const string &in_smi ) const {
+
+  string h = hash_hex( in_smi );
+  return ( bfs::path( dir_ ) / h.substr( 0 , 2 ) / h ).string();
+
+}
@@ -0,0 +1,61 @@
+//
+// file RunSummary.cc
+// agent
+// 19th October 2026
+//
+
+#include "RunSummary.H"
+
+#include <iostream>
+
+using namespace std;
+
+// ****************************************************************************
+RunSummary::RunSummary() :
+  passthrough_used_( false ) , num_tested_( 0 ) , num_passed_( 0 ) ,
+  result_cache_used_( false ) , hits_( 0 ) , misses_( 0 ) , adds_( 0 ) {
+
+}
+
+// ****************************************************************************
+void RunSummary::add_passthrough( unsigned long num_tested , unsigned long num_passed ) {
+
+  boost::mutex::scoped_lock lock( mutex_ );
+  passthrough_used_ = true;
+  num_tested_ += num_tested;
+  num_passed_ += num_passed;
+
+}
+
+// ****************************************************************************
+void RunSummary::add_result_cache( unsigned long hits , unsigned long misses ,
+                                   unsigned long adds , const string &cache_dir ) {
+
+  boost::mutex::scoped_lock lock( mutex_ );
+  result_cache_used_ = true;
+  hits_ += hits;
+  misses_ += misses;
+  adds_ += adds;
+  // it's the same for all the threads
+  cache_dir_ = cache_dir;
+
+}
+
+// ****************************************************************************
+// Only called once the threads have finished, so there's no need for the lock.
+void RunSummary::report( ostream &os ) const {
+
+  if( passthrough_used_ ) {
+    os << "Passed through untouched : " << num_passed_ << " of " << num_tested_
+       << " molecules";
+    if( num_tested_ ) {
+      os << " (" << 100.0 * double( num_passed_ ) / double( num_tested_ ) << "%)";
+    }
+    os << "." << endl;
+  }
+  if( result_cache_used_ ) {
+    os << "Result cache : " << hits_ << " hits, " << misses_ << " misses, "
+       << adds_ << " new entries in " << cache_dir_ << "." << endl;
+  }
+
+}
@@ -0,0 +1,78 @@
+//
+// file SmilesWriter.cc
+// agent
+// 18th October 2026
+//
+
+#include "SmilesWriter.H"
+#include "FileExceptions.H"
+
+#include <iostream>
+
+#include <oechem.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+using namespace std;
+using namespace OEChem;
+
+namespace DACLIB {
+string tagged_cansmi( const OEMolBase &mol ); // in cansmi_tag.cc
+}
+
+// ****************************************************************************
+SmilesWriter::SmilesWriter( const string &filename ) :
+  os_( &cout ) , isomeric_( boost::algorithm::iends_with( filename , ".ism" ) ) {
+
+  if( filename == ".smi" || filename == ".ism" ) {
+    return;
+  }
+  ofs_.open( filename.c_str() );
+  if( !ofs_ || !ofs_.good() ) {
+    throw DACLIB::FileWriteOpenError( filename.c_str() );
+  }
+  os_ = &ofs_;
+
+}
+
+// ****************************************************************************
+void SmilesWriter::write( const OEMolBase &mol ) {
+
+  // the flavours are the ones fix_output_smiles_format in taut_enum.cc gives
+  // the oemolostream.
+  string smi;
+  if( !isomeric_ ) {
+    OECreateSmiString( smi , mol , ( OEOFlavor::SMI::Default ^ OEOFlavor::SMI::AtomMaps ) |
+                       OEOFlavor::SMI::Canonical );
+  } else {
+    // the canonical SMILES tag doesn't have isotopes, so they need doing
+    // from scratch.
+    for( OESystem::OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+      if( atom->GetIsotope() ) {
+        OECreateSmiString( smi , mol , ( OEOFlavor::ISM::Default ^ OEOFlavor::SMI::AtomMaps ) |
+                           OEOFlavor::SMI::Canonical | OESMILESFlag::AtomStereo |
+                           OESMILESFlag::BondStereo );
+        break;
+      }
+    }
+    if( smi.empty() ) {
+      smi = DACLIB::tagged_cansmi( mol );
+    }
+  }
+
+  boost::mutex::scoped_lock lock( mutex_ );
+  *os_ << smi;
+  if( *mol.GetTitle() ) {
+    *os_ << " " << mol.GetTitle();
+  }
+  *os_ << "\n";
+
+}
+
+// ****************************************************************************
+bool SmilesWriter::handles( const string &filename ) {
+
+  return boost::algorithm::iends_with( filename , ".smi" ) ||
+      boost::algorithm::iends_with( filename , ".ism" );
+
+}
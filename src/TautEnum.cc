@@ -6,6 +6,12 @@
 //
 
 #include "TautEnum.H"
+#include "BindingCache.H"
+#include "CompiledTautRule.H"
+#include "DACOEMolAtomIndex.H"
+#include "MatchSymmetry.H"
+#include "SMARTSExceptions.H"
+#include "TautGraph.H"
 #include "chrono.h"
 
 #include <oechem.h>
@@ -15,6 +21,8 @@
 #include <boost/foreach.hpp>
 // #include <boost/thread.hpp>
 
+#include <deque>
+
 using namespace boost;
 using namespace std;
 using namespace OEChem;
@@ -31,22 +39,39 @@ void expand_vector_bindings( const vector<pair<string,string> > &in_smirks ,
                              vector<pair<string,string> > &vbs ,
                              vector<string> &exp_smirks );
 string create_cansmi( const OEMolBase &in_mol );
+void set_cansmi_tag( OEMolBase &mol , const string &smi ); // in cansmi_tag.cc
+string tagged_cansmi( const OEMolBase &mol ); // in cansmi_tag.cc
 void create_libgens( const vector<string> &exp_smirks ,
                      const vector<pair<string,string> > &in_smirks ,
                      vector<pOELibGen> &lib_gens );
 OESubSearch *create_oesubsearch( const string &smarts , bool reorder ); // in eponymous file
 string extract_smarts_from_smirks( const string &smirks ); // in eponymous file
+bool perceive_tautomer( OEMolBase &mol , const OEMolBase &parent ); // in eponymous file
+bool stereo_specified( const OEMolBase &mol ); // in perceive_tautomer.cc
 void radical_atoms( OEMolBase &mol , vector<OEAtomBase *> &rad_atoms ); // in eponymous file
+bool radical_atom( const OEAtomBase &atom ); // in radical_atoms.cc
+int smarts_radius( const string &smarts ); // in eponymous file
+void tag_skeleton_classes( OEMolBase &mol ); // in skeleton_cankey.cc
+bool skeleton_canonical_key( const OEMolBase &mol , string &key ); // in skeleton_cankey.cc
+bool skeleton_connectivity_key( const OEMolBase &mol , string &key ); // in skeleton_cankey.cc
+bool smirks_edit_signature( const string &smirks ,
+                            vector<pair<char,char> > &bond_changes ,
+                            unsigned int &num_h_moves ); // in eponymous file
 }
 
 // ****************************************************************************
 // in canned_tautenum_routines.cc
 OEMolBase *build_copy_of_mol( OEMolBase &mol );
 
+// the bounded enumeration looks at up to this many times max_out_mols_
+// tautomers before picking the best.
+static const size_t BOUNDED_SEARCH_FACTOR = 4;
+
 // ****************************************************************************
 // 1 and only 1 of original_enumeration or extended_enumeration must be true
 TautEnum::TautEnum( const string &smirks_string , const string &vbs_string ,
-                    unsigned int max_t ) : max_out_mols_( max_t ) {
+                    unsigned int max_t ) : max_out_mols_( max_t ) , native_engine_( false ) ,
+  bounded_( false ) {
 
 #ifdef NOTYET
   cout << "Loading enumeration SMIRKS from string" << endl << smirks_string << endl;
@@ -65,7 +90,8 @@ TautEnum::TautEnum( const string &smirks_string , const string &vbs_string ,
 // ****************************************************************************
 TautEnum::TautEnum( const string &smirks_file , const string &vb_file ,
                     bool dummy __attribute__((unused)) , unsigned int max_t ) :
-  smirks_file_( smirks_file ) , vb_file_( vb_file ) , max_out_mols_( max_t ) {
+  smirks_file_( smirks_file ) , vb_file_( vb_file ) , max_out_mols_( max_t ) ,
+  native_engine_( false ) , bounded_( false ) {
 
 #ifdef NOTYET
   cout << "loading enumeration smirks from " << smirks_file
@@ -84,7 +110,9 @@ TautEnum::TautEnum( const string &smirks_file , const string &vb_file ,
 
 // ****************************************************************************
 // copy c'tor, needed for threading.
-TautEnum::TautEnum( const TautEnum &rhs ) : max_out_mols_( rhs.max_out_mols_ ) {
+TautEnum::TautEnum( const TautEnum &rhs ) : max_out_mols_( rhs.max_out_mols_ ) ,
+  native_engine_( rhs.native_engine_ ) , bounded_( rhs.bounded_ ) ,
+  product_tracer_( rhs.product_tracer_ ) {
 
   smirks_file_ = rhs.smirks_file_;
   vb_file_ = rhs.vb_file_;
@@ -94,6 +122,8 @@ TautEnum::TautEnum( const TautEnum &rhs ) : max_out_mols_( rhs.max_out_mols_ ) {
 
   // lib_gens_ is filled from exp_smirks_ as required, so not copying it here.  A deep
   // copy would have been required otherwise, I mention for future reference.
+  // Likewise the rule screens, compiled rules and binding searches, which are made
+  // at the same time.
 
 }
 
@@ -103,154 +133,647 @@ TautEnum::TautEnum( const TautEnum &rhs ) : max_out_mols_( rhs.max_out_mols_ ) {
 vector<OEMolBase *> TautEnum::enumerate( OEMolBase &in_mol , bool verbose ,
                                          bool add_smirks_to_name ) {
 
+  set<string> all_can_smis;
+  return enumerate( vector<OEMolBase *>( 1 , &in_mol ) , all_can_smis , verbose ,
+                    add_smirks_to_name );
+
+}
+
+// ****************************************************************************
+vector<OEMolBase *> TautEnum::enumerate( const vector<OEMolBase *> &in_mols ,
+                                         set<string> &all_can_smis ,
+                                         bool verbose , bool add_smirks_to_name ) {
+
+  if( in_mols.empty() ) {
+    return vector<OEMolBase *>();
+  }
+
 #ifdef NOTYET
-  cout << "Generating tautomers for " << in_mol.GetTitle() << " : "
-       << DACLIB::create_cansmi( in_mol ) << endl;
+  cout << "Generating tautomers for " << in_mols.front()->GetTitle() << " : "
+       << DACLIB::create_cansmi( *in_mols.front() ) << endl;
 #endif
 
-  set<string> all_can_smis;
-  all_can_smis.insert( DACLIB::create_cansmi( in_mol ) );
+  EnumState es( *in_mols.front() , all_can_smis , verbose , add_smirks_to_name );
+  if( bounded_ ) {
+    es.search_limit_ = BOUNDED_SEARCH_FACTOR * max_out_mols_;
+  }
+  start_enumeration( in_mols , es );
+
+  vector<OEMolBase *> &ret_mols = es.ret_mols_;
+  if( bounded_ ) {
+    enumerate_best_first( es );
+  } else {
+    size_t next_start = 0;
+    while( true ) {
+      // only do tautomers added in the last round. There should be no further products
+      // possible from the results of rounds previous to that, as they will already be
+      // in ret_mols.
+      size_t start_size = ret_mols.size();
+#ifdef NOTYET
+      cout << "Next start, current set are : " << endl;
+      BOOST_FOREACH( string smi , es.all_can_smis_ ) {
+        cout << smi << endl;
+      }
+#endif
+
+      for( size_t i = next_start , is = ret_mols.size() ; i < is ; ++i ) {
+        expand_tautomer( i , es );
+      }
+#ifdef NOTYET
+      cout << "Number of tautomers currently : " << ret_mols.size() << endl;
+      BOOST_FOREACH( OEMolBase *rm , ret_mols ) {
+        cout << DACLIB::create_cansmi( *rm ) << endl;
+      }
+#endif
+
+      if( start_size == ret_mols.size() ) {
+        break;
+      } else {
+        next_start = start_size;
+      }
+    }
+  }
+
+  // the map indices were only needed during the enumeration
+  BOOST_FOREACH( OEMolBase *rm , ret_mols ) {
+    for( OEIter<OEAtomBase> atom = rm->GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+      atom->SetMapIdx( 0 );
+    }
+  }
+
+  if( bounded_ && ret_mols.size() > max_out_mols_ ) {
+    keep_best( es );
+  }
 
-  vector<OEMolBase *> ret_mols;
-  ret_mols.push_back( OENewMolBase( in_mol , OEMolBaseType::OEDefault ) );
+  if( es.verbose_ && es.inverse_skips_ ) {
+    cout << "Products not made because they'd have been the tautomer's parent : "
+         << es.inverse_skips_ << endl;
+  }
+  if( es.verbose_ && es.key_duplicates_ ) {
+    cout << "Products found to be duplicates by their skeleton keys : "
+         << es.key_duplicates_ << endl;
+  }
+  if( es.verbose_ && es.symmetry_skips_ ) {
+    cout << "Products not made because they were symmetry equivalent to another : "
+         << es.symmetry_skips_ << endl;
+  }
+
+  // put molecules in consistent order
+  vector<pair<string,OEMolBase *> > smiles;
+  create_smiles( ret_mols , smiles );
+
+  vector<OEMolBase *> sorted_mols;
+  transform( smiles.begin() , smiles.end() ,
+             back_inserter( sorted_mols ) ,
+             bind( &pair<string,OEMolBase *>::second, _1 ) );
+
+  return sorted_mols;
+
+}
+
+// ****************************************************************************
+// Put the input molecules, less any already in es.all_can_smis_, into es as
+// the first tautomers, and make sure the SMIRKS are ready.
+void TautEnum::start_enumeration( const vector<OEMolBase *> &in_mols , EnumState &es ) {
+
+  BOOST_FOREACH( OEMolBase *in_mol , in_mols ) {
+    string in_smi = DACLIB::tagged_cansmi( *in_mol );
+    if( !es.all_can_smis_.insert( in_smi ).second ) {
+      continue;
+    }
+    es.ret_mols_.push_back( OENewMolBase( *in_mol , OEMolBaseType::OEDefault ) );
+    DACLIB::set_cansmi_tag( *es.ret_mols_.back() , in_smi );
+    // the tautomers are all copies of this, so keep the tags
+    DACLIB::tag_skeleton_classes( *es.ret_mols_.back() );
+    es.parents_.push_back( -1 );
+    vector<OEAtomBase *> rad_atoms;
+    DACLIB::radical_atoms( *in_mol , rad_atoms );
+    es.rad_counts_.push_back( static_cast<unsigned int>( rad_atoms.size() ) );
+    es.max_rads_.push_back( static_cast<unsigned int>( rad_atoms.size() ) );
+    es.made_by_.push_back( -1 );
+    es.made_edits_.push_back( TautEdit() );
+    es.scores_.push_back( tautomer_score( *in_mol ) );
+  }
 
   // make the libgen objects up front if not already done
   if( lib_gens_.empty() ) {
     DACLIB::create_libgens( exp_smirks_ , smirks_ , lib_gens_ );
+    create_rule_screens();
+    create_compiled_rules();
+    create_binding_searches();
+    create_inverse_rules();
   }
 
-  vector<OEAtomBase *> input_rad_atoms;
-  DACLIB::radical_atoms( in_mol , input_rad_atoms );
+}
 
-  size_t next_start = 0;
-  while( true ) {
-    // only do tautomers added in the last round. There should be no further products
-    // possible from the results of rounds previous to that, as they will already be
-    // in ret_mols.
-    size_t start_size = ret_mols.size();
-#ifdef NOTYET
-    cout << "Next start, current set are : " << endl;
-    BOOST_FOREACH( string smi , all_can_smis ) {
-      cout << smi << endl;
-    }
-#endif
+// ****************************************************************************
+// Apply all the SMIRKS to tautomer i, adding the new products to es.
+void TautEnum::expand_tautomer( size_t i , EnumState &es ) {
 
-    for( size_t i = next_start , is = ret_mols.size() ; i < is ; ++i ) {
+  vector<OEMolBase *> &ret_mols = es.ret_mols_;
+  vector<vector<unsigned int> > &num_matches = es.num_matches_;
+  vector<pBindingBits> &binding_bits = es.binding_bits_;
 
-      int smirks_num = 0;
-      BOOST_FOREACH( pOELibGen libgen , lib_gens_ ) {
+  // all the libgens use the tautomer itself as their starting material,
+  // prepared just once.
+  OEMolBase *start_mol = ret_mols[i];
+  prepare_starting_material( *start_mol );
+  if( es.parents_[i] < 0 && !DACLIB::stereo_specified( *start_mol ) ) {
+    string can_key;
+    if( DACLIB::skeleton_canonical_key( *start_mol , can_key ) && !can_key.empty() ) {
+      es.can_keys_.insert( can_key );
+    }
+  }
+  vector<int> edit_dists;
+  if( es.parents_[i] >= 0 ) {
+    distances_from_edit( *start_mol , edit_dists );
+  }
+  // in bounded mode they're not done in order
+  if( num_matches.size() <= i ) {
+    num_matches.resize( i + 1 );
+    binding_bits.resize( i + 1 );
+  }
+  num_matches[i] = vector<unsigned int>( lib_gens_.size() , 0 );
+  // for the compiled rules, made when first needed
+  boost::shared_ptr<TautGraph> taut_graph;
+  boost::shared_ptr<BindingCache> binding_cache;
+  // the atoms must be tagged before any products are made from start_mol,
+  // for the BindingCache and so the products' perception can use start_mol's
+  vector<int> prev_atom_idx;
+  BindingCache::tag_atoms( *start_mol , prev_atom_idx );
+  // in tag order, so a product's atoms can be traced back
+  vector<OEAtomBase *> start_atoms;
+  for( OEIter<OEAtomBase> atom = start_mol->GetAtoms() ; atom ; ++atom ) {
+    start_atoms.push_back( atom );
+  }
+  // what would take this tautomer back to its parent, for the SMIRKS that
+  // might reverse the one that made it. Their products are checked against
+  // it before any more work is done on them. Not if every product is to be
+  // traced, though.
+  TautEdit undo_edit;
+  parent_edit( i , es , prev_atom_idx , undo_edit );
+  vector<char> check_inverse( lib_gens_.size() , 0 );
+  if( undo_edit.known_ ) {
+    BOOST_FOREACH( unsigned int r , inverse_rules_[es.made_by_[i]] ) {
+      check_inverse[r] = 1;
+    }
+  }
+  TautEdit prod_edit;
+  // matches of a SMIRKS that are the same as an earlier one by symmetry
+  // would only make the same product again. Not if every product is to be
+  // traced, though.
+  MatchSymmetry match_sym( *start_mol );
+  vector<OEAtomBase *> sym_match;
+
+  int smirks_num = 0;
+  BOOST_FOREACH( pOELibGen libgen , lib_gens_ ) {
 
 #ifdef NOTYET
-        cout << "NEXT SMIRKS : " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second
-             << " : " << exp_smirks_[smirks_num] << endl << endl;
+    cout << "NEXT SMIRKS : " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second
+         << " : " << exp_smirks_[smirks_num] << endl << endl;
 #endif
 
-        libgen->SetAssignMapIdx( false ); // don't need map indices for this
-        libgen->SetStartingMaterial( *ret_mols[i] , 0 , false );
-        // this is a new function from 2013.Feb beta release that we're testing
-        // at the moment.
-        libgen->SetValidateKekule( false );
+    // if the SMIRKS didn't match the parent, and can't match around the atoms
+    // changed in making this one, there's no point trying it again.
+    if( es.parents_[i] >= 0 && !num_matches[es.parents_[i]][smirks_num] &&
+        !could_match_near_edit( smirks_num , *start_mol , edit_dists ) ) {
+      ++smirks_num;
+      continue;
+    }
 
-        OEIter<OEMolBase> prod = libgen->GetProducts();
-        if( prod ) {
+    if( native_engine_ && compiled_rules_[smirks_num] ) {
+      if( !taut_graph ) {
+        taut_graph.reset( new TautGraph( *start_mol ) );
+        binding_bits[i].reset( new BindingBits );
+        binding_cache.reset( new BindingCache( *binding_bits[i] , *start_mol ,
+                                               *taut_graph , vb_searches_ ) );
+        if( es.parents_[i] >= 0 && binding_bits[es.parents_[i]] ) {
+          binding_cache->inherit( *binding_bits[es.parents_[i]] , prev_atom_idx ,
+                                  edit_dists , vb_radii_ );
+        }
+      }
+      const CompiledTautRule &rule = *compiled_rules_[smirks_num];
+      vector<vector<unsigned int> > matches;
+      rule.match( *taut_graph , *binding_cache , matches );
+      num_matches[i][smirks_num] = static_cast<unsigned int>( matches.size() );
+      vector<OEAtomBase *> prod_match;
+      BOOST_FOREACH( const vector<unsigned int> &match , matches ) {
+        if( !product_tracer_ && matches.size() > 1 ) {
+          sym_match.clear();
+          BOOST_FOREACH( unsigned int m , match ) {
+            sym_match.push_back( taut_graph->atom( m ) );
+          }
+          if( match_sym.seen( smirks_num , sym_match ) ) {
+            ++es.symmetry_skips_;
+            continue;
+          }
+        }
+        if( !product_tracer_ && check_inverse[smirks_num] ) {
+          make_native_edit( rule , *taut_graph , match , prod_edit );
+          if( prod_edit == undo_edit ) {
+            ++es.inverse_skips_;
+            continue;
+          }
+        }
+        OEMolBase *prod_mol = rule.apply( *start_mol , match , &prod_match );
+        MatchedAtoms matched;
+        for( unsigned int j = 0 , js = rule.num_atoms() ; j < js ; ++j ) {
+          matched.push_back( make_pair( taut_graph->atom( match[j] ) , prod_match[j] ) );
+        }
+        add_product( prod_mol , *start_mol , start_atoms , i , smirks_num , matched , es );
+      }
+      ++smirks_num;
+      continue;
+    }
+
+    // the map indices mark the atoms altered by the SMIRKS, which the products'
+    // own children will need to know about.
+    libgen->SetAssignMapIdx( true );
+    num_matches[i][smirks_num] = libgen->SetStartingMaterial( *start_mol , 0 , false );
+    // this is a new function from 2013.Feb beta release that we're testing
+    // at the moment.
+    libgen->SetValidateKekule( false );
+
+    OEIter<OEMolBase> prod = libgen->GetProducts();
+    if( prod ) {
 #ifdef NOTYET
-          // this isn't really needed any more.  Run taut_enum with --verbose.
-          cout << endl << "Prod for next libgen" << endl;
-          cout << "SMIRKS : " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second << endl;
-          cout << "Expanded SMIRKS : " << exp_smirks_[smirks_num] << endl;
-          string inputsmi;
-          OECreateCanSmiString( inputsmi , *ret_mols[i] );
-          cout << "Input SMILES : " << inputsmi << endl;
+      // this isn't really needed any more.  Run taut_enum with --verbose.
+      cout << endl << "Prod for next libgen" << endl;
+      cout << "SMIRKS : " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second << endl;
+      cout << "Expanded SMIRKS : " << exp_smirks_[smirks_num] << endl;
+      string inputsmi;
+      OECreateCanSmiString( inputsmi , *ret_mols[i] );
+      cout << "Input SMILES : " << inputsmi << endl;
 #endif
-          for( ; prod ; ++prod ) {
+      for( ; prod ; ++prod ) {
 #ifdef NOTYET
-            cout << "raw prod_mol : " << DACLIB::create_cansmi( *prod ) << endl;
+        cout << "raw prod_mol : " << DACLIB::create_cansmi( *prod ) << endl;
 #endif
-            // Up to OEToolkits v 2012.Oct (v1.9.0) some molecules with extended
-            // aromaticity got screwed up by some of the SMIRKS. e.g.
-            // c1ccc2c(c1)c(=O)c3ccc4c(c3c2=O)[nH]c5ccc6c(=O)ccc(=O)c6c5[nH]4
-            // when tackled with
-            // SMIRKS : ENUM_AROM_9_4 : [H:8][n;H1;X3;!+:1]:[$CAR:2]:[$CAR:3]:[$CAR:4]:[$CAR:5]:[c:6]=[$REV_OS:7]>>[*:1]:[*:2]:[*:3]:[*:4]:[*:5]:[c:6]-[*:7][H:8]
-            // gives, inter alia, c1ccc2c(c1)C(=O)c3ccc4c(c3C2=O)nc5ccc6c(c5n4)C(=O)[CH]C=C6O
-            // where similar rings such as c1cc2c(c3c1[nH]c4c5c(cc(c4[nH]3))c(=O)c6ccccc6c5=O)c(=O)c7ccccc7c2=O
-            // are ok.
-            OEMolBase *prod_mol = OENewMolBase( *prod , OEMolBaseType::OEDefault );
-            OEFindRingAtomsAndBonds( *prod_mol );
-            OEAssignAromaticFlags( *prod_mol );
-            OEPerceiveChiral( *prod_mol );
-            vector<OEAtomBase *> prod_rad_atoms;
-            DACLIB::radical_atoms( *prod_mol , prod_rad_atoms );
-            if( prod_rad_atoms.size() > input_rad_atoms.size() ) {
-              // we don't want products that have created free radicals. We'd rather the SMIRKS
-              // toolkit didn't make them in the first place, of course...
-              string smi = DACLIB::create_cansmi( *prod_mol );
-              if( verbose ) {
-                cout << "AWOOGA - got some radicals for " << in_mol.GetTitle() << " : " << smi << endl;
-              }
-              delete prod_mol;
-            } else {
-              // fix any chiral centres that may have been affected by reaction
-              remove_altered_stereochem( libgen , prod_mol );
-              string smi = DACLIB::create_cansmi( *prod_mol );
-              if( all_can_smis.find( smi ) == all_can_smis.end() ) {
-                if( add_smirks_to_name ) {
-                  string curr_name = prod_mol->GetTitle();
-                  curr_name += string( " " ) + smirks_[smirks_num].first;
-                  prod_mol->SetTitle( curr_name );
-                }
-                ret_mols.push_back( prod_mol );
-                if( ret_mols.size() > max_out_mols_ ) {
-                  // it's going to take too long
-                  for( size_t j = 0 , js = ret_mols.size() ; j < js ; ++j ) {
-                    delete ret_mols[j];
-                  }
-                  ret_mols.clear();
-                  throw TooManyOutMols( in_mol );
-                }
-                all_can_smis.insert( smi );
-                if( verbose ) {
-                  cout << endl << "New product in tautomer enumerator : " << smi << endl
-                       << "Made from " << DACLIB::create_cansmi( *ret_mols[i] ) << endl
-                       << "Using SMIRKS : " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second << endl
-                       << "Expanded to : " << exp_smirks_[smirks_num] << endl;
-                }
-              } else {
-                delete prod_mol; // we've already got this molecule
-              }
-            }
+        if( !product_tracer_ && num_matches[i][smirks_num] > 1 ) {
+          libgen_match( start_atoms , *prod , sym_match );
+          if( !sym_match.empty() && match_sym.seen( smirks_num , sym_match ) ) {
+            ++es.symmetry_skips_;
+            continue;
           }
-        } else {
-#ifdef NOTYET
-          cout << "No prods for this libgen" << endl;
-#endif
         }
-        ++smirks_num; // counter for libgen/smirks, for debugging
+        if( !product_tracer_ && check_inverse[smirks_num] ) {
+          make_edit( start_atoms , *prod , prod_edit );
+          if( prod_edit == undo_edit ) {
+            ++es.inverse_skips_;
+            continue;
+          }
+        }
+        OEMolBase *prod_mol = OENewMolBase( *prod , OEMolBaseType::OEDefault );
+        MatchedAtoms matched;
+        match_by_tag( start_atoms , *prod_mol , matched );
+        add_product( prod_mol , *start_mol , start_atoms , i , smirks_num , matched , es );
       }
-    }
+      // the libgen will have left its map indices on the shared starting material,
+      // and they'd confuse match_by_map_idx for the next SMIRKS.
+      for( OEIter<OEAtomBase> atom = start_mol->GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+        atom->SetMapIdx( 0 );
+      }
+    } else {
 #ifdef NOTYET
-    cout << "Number of tautomers currently : " << ret_mols.size() << endl;
-    BOOST_FOREACH( OEMolBase *rm , ret_mols ) {
-      cout << DACLIB::create_cansmi( *rm ) << endl;
-    }
+      cout << "No prods for this libgen" << endl;
 #endif
+    }
+    ++smirks_num; // counter for libgen/smirks, for debugging
+  }
 
-    if( start_size == ret_mols.size() ) {
-      break;
+}
+
+// ****************************************************************************
+// The tautomers are expanded best first, by score and then SMILES, so which
+// ones are found before the budget runs out is always the same.
+void TautEnum::enumerate_best_first( EnumState &es ) {
+
+  typedef pair<pair<int,int>,pair<string,size_t> > QueueEntry;
+  set<QueueEntry> to_do;
+  for( size_t i = 0 , is = es.ret_mols_.size() ; i < is ; ++i ) {
+    to_do.insert( make_pair( es.scores_[i] ,
+                             make_pair( DACLIB::tagged_cansmi( *es.ret_mols_[i] ) , i ) ) );
+  }
+
+  while( !to_do.empty() && !es.budget_full_ ) {
+    size_t i = to_do.begin()->second.second;
+    to_do.erase( to_do.begin() );
+    size_t old_size = es.ret_mols_.size();
+    expand_tautomer( i , es );
+    for( size_t j = old_size , js = es.ret_mols_.size() ; j < js ; ++j ) {
+      to_do.insert( make_pair( es.scores_[j] ,
+                               make_pair( DACLIB::tagged_cansmi( *es.ret_mols_[j] ) , j ) ) );
+    }
+  }
+
+}
+
+// ****************************************************************************
+// The ones that go are taken out of all_can_smis_ as well, so it still has
+// just the ones returned.
+void TautEnum::keep_best( EnumState &es ) {
+
+  // input molecules first, then by score and SMILES
+  typedef pair<pair<bool,pair<int,int> >,pair<string,size_t> > Ranked;
+  vector<Ranked> ranked;
+  for( size_t i = 0 , is = es.ret_mols_.size() ; i < is ; ++i ) {
+    ranked.push_back( make_pair( make_pair( es.parents_[i] >= 0 , es.scores_[i] ) ,
+                                 make_pair( DACLIB::tagged_cansmi( *es.ret_mols_[i] ) , i ) ) );
+  }
+  sort( ranked.begin() , ranked.end() );
+
+  if( es.verbose_ ) {
+    cout << "Bounded enumeration keeping the best " << max_out_mols_ << " of "
+         << ranked.size() << " tautomers found";
+    if( es.budget_full_ ) {
+      cout << " before the search was stopped";
+    }
+    cout << "." << endl;
+  }
+
+  vector<OEMolBase *> kept;
+  for( size_t i = 0 , is = ranked.size() ; i < is ; ++i ) {
+    OEMolBase *mol = es.ret_mols_[ranked[i].second.second];
+    if( i < max_out_mols_ || es.parents_[ranked[i].second.second] < 0 ) {
+      kept.push_back( mol );
     } else {
-      next_start = start_size;
+      es.all_can_smis_.erase( ranked[i].second.first );
+      delete mol;
     }
   }
+  es.ret_mols_ = kept;
 
-  // put molecules in consistent order
-  vector<pair<string,OEMolBase *> > smiles;
-  create_smiles( ret_mols , smiles );
+}
 
-  ret_mols.clear();
-  transform( smiles.begin() , smiles.end() ,
-             back_inserter( ret_mols ) ,
-             bind( &pair<string,OEMolBase *>::second, _1 ) );
+// ****************************************************************************
+// The tautomers are expanded best first, as for the bounded enumeration, and
+// the best so far kept. A tautomer that ties on score with the best so far
+// but has a smaller SMILES may only be reachable through worse ones, so the
+// search has to see them all and there's no stopping early. If it reaches
+// the search limit first, the best is only the best of those it found,
+// which depends on in_mol, and complete is false. The SMILES of the
+// tautomers aren't needed for anything else, so all_can_smis is local.
+OEMolBase *TautEnum::canonical_tautomer( OEMolBase &in_mol , bool &complete ,
+                                         bool verbose , bool add_smirks_to_name ) {
+
+  set<string> all_can_smis;
+  EnumState es( in_mol , all_can_smis , verbose , add_smirks_to_name );
+  es.search_limit_ = BOUNDED_SEARCH_FACTOR * max_out_mols_;
+  start_enumeration( vector<OEMolBase *>( 1 , &in_mol ) , es );
+
+  typedef pair<pair<int,int>,pair<string,size_t> > QueueEntry;
+  QueueEntry best = make_pair( es.scores_[0] ,
+                               make_pair( DACLIB::tagged_cansmi( *es.ret_mols_[0] ) , size_t( 0 ) ) );
+  set<QueueEntry> to_do;
+  to_do.insert( best );
+
+  while( !to_do.empty() && !es.budget_full_ ) {
+    size_t i = to_do.begin()->second.second;
+    to_do.erase( to_do.begin() );
+    size_t old_size = es.ret_mols_.size();
+    expand_tautomer( i , es );
+    for( size_t j = old_size , js = es.ret_mols_.size() ; j < js ; ++j ) {
+      QueueEntry entry = make_pair( es.scores_[j] ,
+                                    make_pair( DACLIB::tagged_cansmi( *es.ret_mols_[j] ) , j ) );
+      to_do.insert( entry );
+      if( entry < best ) {
+        best = entry;
+      }
+    }
+  }
+  complete = !es.budget_full_;
+
+  if( es.verbose_ ) {
+    cout << "Canonical tautomer search looked at " << es.ret_mols_.size() << " tautomers";
+    if( !complete ) {
+      cout << " and was stopped before it had seen them all";
+    }
+    cout << "." << endl;
+  }
+
+  OEMolBase *ret_mol = es.ret_mols_[best.second.second];
+  for( size_t i = 0 , is = es.ret_mols_.size() ; i < is ; ++i ) {
+    if( i != best.second.second ) {
+      delete es.ret_mols_[i];
+    }
+  }
+  for( OEIter<OEAtomBase> atom = ret_mol->GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+    atom->SetMapIdx( 0 );
+  }
+
+  return ret_mol;
+
+}
+
+// ****************************************************************************
+// The search goes out from both molecules at once, breadth first, each step
+// expanding the next tautomer on the side that has found fewer, and each
+// side's new tautomers looked up in the other's SMILES. The first one found
+// in both settles it. The answer is no only once both sides have run out of
+// tautomers. One side running out isn't enough, because the SMIRKS needn't
+// all be reversible, and max_rads_ depends on the molecule the search
+// started from, so the other side may still reach one of them without
+// either molecule being reachable from the other.
+bool TautEnum::are_tautomers( OEMolBase &mol_a , OEMolBase &mol_b , bool verbose ) {
+
+  if( tautomer_invariants_differ( mol_a , mol_b ) ) {
+    if( verbose ) {
+      cout << mol_a.GetTitle() << " and " << mol_b.GetTitle()
+           << " differ in formula, charge or skeleton." << endl;
+    }
+    return false;
+  }
+
+  set<string> can_smis_a , can_smis_b;
+  EnumState es_a( mol_a , can_smis_a , verbose , false );
+  EnumState es_b( mol_b , can_smis_b , verbose , false );
+  es_a.search_limit_ = es_b.search_limit_ = max_out_mols_;
+  start_enumeration( vector<OEMolBase *>( 1 , &mol_a ) , es_a );
+  start_enumeration( vector<OEMolBase *>( 1 , &mol_b ) , es_b );
+
+  bool found = can_smis_b.end() != can_smis_b.find( *can_smis_a.begin() );
+  size_t next_a = 0 , next_b = 0;
+  while( !found ) {
+    bool a_open = next_a < es_a.ret_mols_.size() && !es_a.budget_full_;
+    bool b_open = next_b < es_b.ret_mols_.size() && !es_b.budget_full_;
+    if( next_a == es_a.ret_mols_.size() && !es_a.budget_full_ &&
+        next_b == es_b.ret_mols_.size() && !es_b.budget_full_ ) {
+      break; // both sides have them all
+    }
+    if( !a_open && !b_open ) {
+      for( size_t i = 0 , is = es_a.ret_mols_.size() ; i < is ; ++i ) {
+        delete es_a.ret_mols_[i];
+      }
+      for( size_t i = 0 , is = es_b.ret_mols_.size() ; i < is ; ++i ) {
+        delete es_b.ret_mols_[i];
+      }
+      throw TooManyOutMols( mol_a );
+    }
+    bool do_a = a_open && ( !b_open || es_a.ret_mols_.size() <= es_b.ret_mols_.size() );
+    EnumState &es = do_a ? es_a : es_b;
+    set<string> &other_smis = do_a ? can_smis_b : can_smis_a;
+    size_t &next = do_a ? next_a : next_b;
+    size_t old_size = es.ret_mols_.size();
+    expand_tautomer( next++ , es );
+    for( size_t j = old_size , js = es.ret_mols_.size() ; j < js ; ++j ) {
+      if( other_smis.end() != other_smis.find( DACLIB::tagged_cansmi( *es.ret_mols_[j] ) ) ) {
+        found = true;
+        break;
+      }
+    }
+  }
 
-  return ret_mols;
+  if( verbose ) {
+    cout << mol_a.GetTitle() << " and " << mol_b.GetTitle() << ( found ? " are" : " aren't" )
+         << " tautomers, after finding " << es_a.ret_mols_.size() << " and "
+         << es_b.ret_mols_.size() << " tautomers of them." << endl;
+  }
+
+  for( size_t i = 0 , is = es_a.ret_mols_.size() ; i < is ; ++i ) {
+    delete es_a.ret_mols_[i];
+  }
+  for( size_t i = 0 , is = es_b.ret_mols_.size() ; i < is ; ++i ) {
+    delete es_b.ret_mols_[i];
+  }
+
+  return found;
+
+}
+
+// ****************************************************************************
+// Finish off a product of SMIRKS smirks_num on tautomer parent, from whichever
+// engine made it, and keep it if it's new. Takes ownership of prod_mol.
+// start_mol is the prepared parent, with map indices on the atoms the SMIRKS
+// matched.
+void TautEnum::add_product( OEMolBase *prod_mol , OEMolBase &start_mol ,
+                            const vector<OEAtomBase *> &start_atoms , size_t parent , int smirks_num , const MatchedAtoms &matched ,
+                            EnumState &es ) {
+
+  if( es.budget_full_ ) {
+    delete prod_mol;
+    return;
+  }
+
+  // Up to OEToolkits v 2012.Oct (v1.9.0) some molecules with extended
+  // aromaticity got screwed up by some of the SMIRKS. e.g.
+  // c1ccc2c(c1)c(=O)c3ccc4c(c3c2=O)[nH]c5ccc6c(=O)ccc(=O)c6c5[nH]4
+  // when tackled with
+  // SMIRKS : ENUM_AROM_9_4 : [H:8][n;H1;X3;!+:1]:[$CAR:2]:[$CAR:3]:[$CAR:4]:[$CAR:5]:[c:6]=[$REV_OS:7]>>[*:1]:[*:2]:[*:3]:[*:4]:[*:5]:[c:6]-[*:7][H:8]
+  // gives, inter alia, c1ccc2c(c1)C(=O)c3ccc4c(c3C2=O)nc5ccc6c(c5n4)C(=O)[CH]C=C6O
+  // where similar rings such as c1cc2c(c3c1[nH]c4c5c(cc(c4[nH]3))c(=O)c6ccccc6c5=O)c(=O)c7ccccc7c2=O
+  // are ok.
+  if( !DACLIB::perceive_tautomer( *prod_mol , start_mol ) ) {
+    OEFindRingAtomsAndBonds( *prod_mol );
+    OEAssignAromaticFlags( *prod_mol );
+  }
+  // chirality only shows in the SMILES if there's some stereochemistry, so for
+  // the rest it can wait until we know the product is a keeper.
+  bool chiral_done = false;
+  if( DACLIB::stereo_specified( *prod_mol ) ) {
+    OEPerceiveChiral( *prod_mol );
+    chiral_done = true;
+  }
+  // Only the matched atoms can have changed, so the product's radicals are its
+  // parent's adjusted for them, unless atoms have come or gone.
+  unsigned int num_rads = 0;
+  if( !matched.empty() && prod_mol->NumAtoms() == start_mol.NumAtoms() ) {
+    int rad_change = 0;
+    for( size_t j = 0 , js = matched.size() ; j < js ; ++j ) {
+      rad_change += int( DACLIB::radical_atom( *matched[j].second ) ) -
+          int( DACLIB::radical_atom( *matched[j].first ) );
+    }
+    num_rads = static_cast<unsigned int>( int( es.rad_counts_[parent] ) + rad_change );
+  } else {
+    vector<OEAtomBase *> prod_rad_atoms;
+    DACLIB::radical_atoms( *prod_mol , prod_rad_atoms );
+    num_rads = static_cast<unsigned int>( prod_rad_atoms.size() );
+  }
+  if( num_rads > es.max_rads_[parent] ) {
+    // we don't want products that have created free radicals. We'd rather the SMIRKS
+    // toolkit didn't make them in the first place, of course...
+    string smi = DACLIB::create_cansmi( *prod_mol );
+    if( es.verbose_ ) {
+      cout << "AWOOGA - got some radicals for " << es.in_mol_.GetTitle() << " : " << smi << endl;
+    }
+    delete prod_mol;
+    return;
+  }
+
+  // fix any chiral centres that may have been affected by reaction
+  if( matched.empty() ) {
+    MatchedAtoms map_matched;
+    match_by_map_idx( start_mol , *prod_mol , map_matched );
+    remove_altered_stereochem( start_mol , map_matched );
+  } else {
+    remove_altered_stereochem( start_mol , matched );
+  }
+  // A product with the same key as one already seen is the same molecule, and
+  // that's quicker to find out than its SMILES. The key doesn't do
+  // stereochemistry.
+  string can_key;
+  if( !product_tracer_ && !chiral_done ) {
+    DACLIB::skeleton_canonical_key( *prod_mol , can_key );
+    if( !can_key.empty() && es.can_keys_.end() != es.can_keys_.find( can_key ) ) {
+      ++es.key_duplicates_;
+      delete prod_mol;
+      return;
+    }
+  }
+  string smi = DACLIB::create_cansmi( *prod_mol );
+  if( product_tracer_ ) {
+    product_tracer_( static_cast<unsigned int>( smirks_num ) ,
+                     DACLIB::tagged_cansmi( *es.ret_mols_[parent] ) , smi );
+  }
+  if( !can_key.empty() ) {
+    es.can_keys_.insert( can_key );
+  }
+  if( es.all_can_smis_.find( smi ) != es.all_can_smis_.end() ) {
+    delete prod_mol; // we've already got this molecule
+    return;
+  }
+
+  if( !chiral_done ) {
+    OEPerceiveChiral( *prod_mol );
+  }
+  if( es.add_smirks_to_name_ ) {
+    string curr_name = prod_mol->GetTitle();
+    curr_name += string( " " ) + smirks_[smirks_num].first;
+    prod_mol->SetTitle( curr_name );
+  }
+  // it's not changed from here on, apart from its title
+  DACLIB::set_cansmi_tag( *prod_mol , smi );
+  es.ret_mols_.push_back( prod_mol );
+  es.parents_.push_back( int( parent ) );
+  es.rad_counts_.push_back( num_rads );
+  es.max_rads_.push_back( es.max_rads_[parent] );
+  es.made_by_.push_back( smirks_num );
+  es.made_edits_.push_back( TautEdit() );
+  // only needed if something might reverse the SMIRKS. If there's any
+  // stereochemistry, the parent made again may have lost some of it, in
+  // which case it isn't the same molecule.
+  if( !inverse_rules_[smirks_num].empty() && !DACLIB::stereo_specified( start_mol ) ) {
+    make_edit( start_atoms , *prod_mol , es.made_edits_.back() );
+  }
+  es.scores_.push_back( tautomer_score( *prod_mol ) );
+  if( es.search_limit_ ) {
+    if( es.ret_mols_.size() >= es.search_limit_ ) {
+      es.budget_full_ = true;
+    }
+  } else if( es.ret_mols_.size() > max_out_mols_ ) {
+    // it's going to take too long
+    for( size_t j = 0 , js = es.ret_mols_.size() ; j < js ; ++j ) {
+      delete es.ret_mols_[j];
+    }
+    es.ret_mols_.clear();
+    throw TooManyOutMols( es.in_mol_ );
+  }
+  es.all_can_smis_.insert( smi );
+  if( es.verbose_ ) {
+    cout << endl << "New product in tautomer enumerator : " << smi << endl
+         << "Made from " << DACLIB::tagged_cansmi( *es.ret_mols_[parent] ) << endl
+         << "Using SMIRKS : " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second << endl
+         << "Expanded to : " << exp_smirks_[smirks_num] << endl;
+  }
 
 }
 
@@ -277,54 +800,541 @@ vector<string> TautEnum::enumerate_smiles( OEMolBase &in_mol , bool verbose ,
 }
 
 // ************************************************************************************
-// remove any stereochemistry from atoms affected by the reaction
-void TautEnum::remove_altered_stereochem( pOELibGen &libgen , OEMolBase *mol ) {
-
-  for( int i = 0 , is = libgen->NumReactants() ; i < is ; ++i ) {
-    OEIter<OEMolBase> sms = libgen->GetStartingMaterial( i );
-    for( ; sms ; ++sms ) {
-      // fix atom stereo
-      for( OEIter<OEAtomBase> atom = sms->GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
-        if( atom->HasStereoSpecified() ) {
-          // cout << "stereo on atom " << atom->GetIdx() << " : " << atom->GetMapIdx() << " for " << sms->GetTitle() << endl;
-          OEIter<OEAtomBase> patom = mol->GetAtoms( OEHasMapIdx( atom->GetMapIdx() ) );
-          if( patom->HasStereoSpecified( OEAtomStereo::Tetra ) ) {
-            if( atom->GetAtomicNum() != patom->GetAtomicNum() ||
-                atom->GetDegree() != patom->GetDegree() ||
-                atom->GetHvyDegree() != patom->GetHvyDegree() ||
-                atom->GetValence() != patom->GetValence() ||
-                atom->GetHvyDegree() != patom->GetHvyDegree() ||
-                atom->GetHyb() != patom->GetHyb() ||
-                atom->GetTotalHCount() != patom->GetTotalHCount() ) {
-              patom->SetStereo( vector<OEAtomBase *>() , OEAtomStereo::Tetra , OEAtomStereo::Undefined );
-              cout << "Stereochem removed for tautomer of " << sms->GetTitle() << endl;
-            }
+// The libgens are built with SetExplicitHydrogens( true ) and given the
+// starting material without copying it, so they'd add the hydrogens to the
+// tautomer anyway, as they always have. Doing it here means the tagging and
+// matching before them see the same atoms. The canonical SMILES doesn't show
+// the explicit hydrogens, so it still holds, but the tag has to be made again
+// because the atoms have changed.
+void TautEnum::prepare_starting_material( OEMolBase &mol ) const {
+
+  string smi = DACLIB::tagged_cansmi( mol );
+  OEAddExplicitHydrogens( mol );
+  OEFindRingAtomsAndBonds( mol );
+  OEAssignAromaticFlags( mol );
+  DACLIB::set_cansmi_tag( mol , smi );
+
+}
+
+// ************************************************************************************
+// For each SMIRKS, how far its reactant pattern can see, and the pattern itself
+// without the explicit hydrogens, for rooted searches. The latter is a bit more
+// permissive than the SMIRKS, which is the right way round for a screen.
+void TautEnum::create_rule_screens() {
+
+  rule_radii_.clear();
+  rule_screens_.clear();
+  for( size_t i = 0 , is = exp_smirks_.size() ; i < is ; ++i ) {
+    rule_radii_.push_back( DACLIB::smarts_radius( exp_smirks_[i].substr( 0 , exp_smirks_[i].find( ">>" ) ) ) );
+    try {
+      rule_screens_.push_back( pOESubSearch( DACLIB::create_oesubsearch( DACLIB::extract_smarts_from_smirks( exp_smirks_[i] ) , false ) ) );
+    } catch( DACLIB::SMARTSDefnError &e ) {
+      // it can't be screened, so will always be tried
+      rule_screens_.push_back( pOESubSearch() );
+    }
+  }
+
+}
+
+// ************************************************************************************
+// The SMIRKS that CompiledTautRule can cope with, so they can be done without a
+// libgen. A null pointer for the rest.
+void TautEnum::create_compiled_rules() {
+
+  compiled_rules_.clear();
+  inline_recs_.clear();
+  for( size_t i = 0 , is = smirks_.size() ; i < is ; ++i ) {
+    // the vector bindings are left as they are, for the BindingCache
+    pCompiledTautRule rule( new CompiledTautRule( smirks_[i].second , vbs_ , inline_recs_ ) );
+    if( !*rule ) {
+      rule.reset();
+    }
+    compiled_rules_.push_back( rule );
+  }
+
+}
+
+// ************************************************************************************
+// A search for each vector binding as a recursive SMARTS on a single atom, so the
+// BindingCache can find out if an atom matches it, and how far the binding can see.
+// Then the same for the in-line recursive SMARTS in the compiled rules, which must
+// have been done first.
+void TautEnum::create_binding_searches() {
+
+  vector<pair<string,string> > vb_atoms;
+  for( size_t i = 0 , is = vbs_.size() ; i < is ; ++i ) {
+    vb_atoms.push_back( make_pair( vbs_[i].first , string( "[$" ) + vbs_[i].first + string( "]" ) ) );
+  }
+  BOOST_FOREACH( const string &rec , inline_recs_ ) {
+    vb_atoms.push_back( make_pair( rec , string( "[$(" ) + rec + string( ")]" ) ) );
+  }
+  vector<string> exp_vb_atoms;
+  DACLIB::expand_vector_bindings( vb_atoms , vbs_ , exp_vb_atoms );
+
+  vb_searches_.clear();
+  vb_radii_.clear();
+  BOOST_FOREACH( const string &smarts , exp_vb_atoms ) {
+    vb_radii_.push_back( DACLIB::smarts_radius( smarts ) );
+    try {
+      vb_searches_.push_back( pOESubSearch( DACLIB::create_oesubsearch( smarts , false ) ) );
+    } catch( DACLIB::SMARTSDefnError &e ) {
+      vb_searches_.push_back( pOESubSearch() );
+    }
+  }
+
+}
+
+// ************************************************************************************
+// Two SMIRKS are paired if one's signature is the other's backwards. That
+// includes a SMIRKS with itself, such as a 1,3-shift between two of the same
+// atom, which is its own reverse.
+void TautEnum::create_inverse_rules() {
+
+  vector<vector<pair<char,char> > > sigs( smirks_.size() );
+  vector<unsigned int> h_moves( smirks_.size() , 0 );
+  vector<char> sig_ok( smirks_.size() , 0 );
+  for( size_t i = 0 , is = smirks_.size() ; i < is ; ++i ) {
+    sig_ok[i] = DACLIB::smirks_edit_signature( smirks_[i].second , sigs[i] , h_moves[i] );
+  }
+
+  inverse_rules_ = vector<vector<unsigned int> >( smirks_.size() );
+  typedef pair<char,char> BOND_CHANGE;
+  for( size_t i = 0 , is = smirks_.size() ; i < is ; ++i ) {
+    vector<pair<char,char> > rev_sig;
+    BOOST_FOREACH( const BOND_CHANGE &bc , sigs[i] ) {
+      rev_sig.push_back( make_pair( bc.second , bc.first ) );
+    }
+    sort( rev_sig.begin() , rev_sig.end() );
+    for( size_t j = 0 ; j < is ; ++j ) {
+      if( !sig_ok[i] || !sig_ok[j] || ( h_moves[i] == h_moves[j] && rev_sig == sigs[j] ) ) {
+        inverse_rules_[i].push_back( static_cast<unsigned int>( j ) );
+      }
+    }
+  }
+
+#ifdef NOTYET
+  for( size_t i = 0 , is = smirks_.size() ; i < is ; ++i ) {
+    cout << smirks_[i].first << " can be reversed by " << inverse_rules_[i].size() << " :";
+    BOOST_FOREACH( unsigned int j , inverse_rules_[i] ) {
+      cout << " " << smirks_[j].first;
+    }
+    cout << endl;
+  }
+#endif
+
+}
+
+// ************************************************************************************
+void TautEnum::make_edit( const vector<OEAtomBase *> &start_atoms ,
+                          const OEMolBase &prod_mol , TautEdit &edit ) const {
+
+  edit = TautEdit();
+  if( start_atoms.empty() || prod_mol.NumAtoms() != start_atoms.size() ||
+      prod_mol.NumBonds() != start_atoms.front()->GetParent()->NumBonds() ) {
+    return;
+  }
+
+  for( OEIter<OEAtomBase> atom = prod_mol.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H == atom->GetAtomicNum() ) {
+      continue;
+    }
+    if( !atom->HasData( DACLIB::ATOM_INDEX_TAG ) ) {
+      return;
+    }
+    unsigned int tag = atom->GetData<unsigned int>( DACLIB::ATOM_INDEX_TAG );
+    if( tag >= start_atoms.size() ||
+        start_atoms[tag]->GetAtomicNum() != atom->GetAtomicNum() ) {
+      return;
+    }
+    int dh = int( atom->GetTotalHCount() ) - int( start_atoms[tag]->GetTotalHCount() );
+    if( dh ) {
+      edit.h_changes_[tag] = dh;
+    }
+    int dq = atom->GetFormalCharge() - start_atoms[tag]->GetFormalCharge();
+    if( dq ) {
+      edit.charge_changes_[tag] = dq;
+    }
+  }
+
+  for( OEIter<OEBondBase> bond = prod_mol.GetBonds() ; bond ; ++bond ) {
+    if( OEElemNo::H == bond->GetBgn()->GetAtomicNum() ||
+        OEElemNo::H == bond->GetEnd()->GetAtomicNum() ) {
+      continue;
+    }
+    unsigned int bt = bond->GetBgn()->GetData<unsigned int>( DACLIB::ATOM_INDEX_TAG );
+    unsigned int et = bond->GetEnd()->GetData<unsigned int>( DACLIB::ATOM_INDEX_TAG );
+    OEBondBase *start_bond = start_atoms[bt]->GetBond( start_atoms[et] );
+    if( !start_bond ) {
+      return;
+    }
+    if( start_bond->GetOrder() != bond->GetOrder() ) {
+      edit.bond_changes_[make_pair( min( bt , et ) , max( bt , et ) )] =
+          make_pair( start_bond->GetOrder() , bond->GetOrder() );
+    }
+  }
+
+  edit.known_ = true;
+
+}
+
+// ************************************************************************************
+// The graph indices are the tags, as both are the atom order of the starting
+// material.
+void TautEnum::make_native_edit( const CompiledTautRule &rule , const TautGraph &graph ,
+                                 const vector<unsigned int> &match ,
+                                 TautEdit &edit ) const {
+
+  edit = TautEdit();
+  vector<pair<unsigned int,unsigned int> > h_moves;
+  vector<pair<pair<unsigned int,unsigned int>,unsigned int> > bond_changes;
+  rule.edits( match , h_moves , bond_changes );
+
+  typedef pair<unsigned int,unsigned int> H_MOVE;
+  BOOST_FOREACH( const H_MOVE &hm , h_moves ) {
+    --edit.h_changes_[hm.first];
+    ++edit.h_changes_[hm.second];
+  }
+  for( map<unsigned int,int>::iterator p = edit.h_changes_.begin() ; p != edit.h_changes_.end() ; ) {
+    if( p->second ) {
+      ++p;
+    } else {
+      edit.h_changes_.erase( p++ );
+    }
+  }
+
+  typedef pair<pair<unsigned int,unsigned int>,unsigned int> BOND_CHANGE;
+  BOOST_FOREACH( const BOND_CHANGE &bc , bond_changes ) {
+    OEBondBase *bond = graph.atom( bc.first.first )->GetBond( graph.atom( bc.first.second ) );
+    if( !bond ) {
+      return;
+    }
+    if( bond->GetOrder() != bc.second ) {
+      edit.bond_changes_[make_pair( min( bc.first.first , bc.first.second ) ,
+                                    max( bc.first.first , bc.first.second ) )] =
+          make_pair( bond->GetOrder() , bc.second );
+    }
+  }
+
+  edit.known_ = true;
+
+}
+
+// ************************************************************************************
+// The edit that made tautomer i, backwards and moved onto its own tags. Not
+// wanted if every product is to go to the tracer.
+void TautEnum::parent_edit( size_t i , const EnumState &es ,
+                            const vector<int> &prev_atom_idx , TautEdit &edit ) const {
+
+  edit = TautEdit();
+  if( product_tracer_ || es.made_by_[i] < 0 || !es.made_edits_[i].known_ ) {
+    return;
+  }
+  const TautEdit &made = es.made_edits_[i];
+
+  vector<int> new_tags;
+  for( size_t j = 0 , js = prev_atom_idx.size() ; j < js ; ++j ) {
+    if( prev_atom_idx[j] < 0 ) {
+      continue;
+    }
+    if( prev_atom_idx[j] >= static_cast<int>( new_tags.size() ) ) {
+      new_tags.resize( prev_atom_idx[j] + 1 , -1 );
+    }
+    new_tags[prev_atom_idx[j]] = static_cast<int>( j );
+  }
+
+  typedef pair<unsigned int,int> ATOM_CHANGE;
+  BOOST_FOREACH( const ATOM_CHANGE &hc , made.h_changes_ ) {
+    if( hc.first >= new_tags.size() || new_tags[hc.first] < 0 ) {
+      return;
+    }
+    edit.h_changes_[new_tags[hc.first]] = -hc.second;
+  }
+  BOOST_FOREACH( const ATOM_CHANGE &qc , made.charge_changes_ ) {
+    if( qc.first >= new_tags.size() || new_tags[qc.first] < 0 ) {
+      return;
+    }
+    edit.charge_changes_[new_tags[qc.first]] = -qc.second;
+  }
+  typedef pair<pair<unsigned int,unsigned int>,pair<unsigned int,unsigned int> > BOND_CHANGE;
+  BOOST_FOREACH( const BOND_CHANGE &bc , made.bond_changes_ ) {
+    if( bc.first.first >= new_tags.size() || new_tags[bc.first.first] < 0 ||
+        bc.first.second >= new_tags.size() || new_tags[bc.first.second] < 0 ) {
+      return;
+    }
+    unsigned int a = new_tags[bc.first.first] , b = new_tags[bc.first.second];
+    edit.bond_changes_[make_pair( min( a , b ) , max( a , b ) )] =
+        make_pair( bc.second.second , bc.second.first );
+  }
+
+  edit.known_ = true;
+
+}
+
+// ************************************************************************************
+// Distance in bonds of each atom in mol from the atoms altered by the SMIRKS that
+// made it, which are the ones with map indices. A ring atom amongst them brings in
+// the rest of its ring system, as the aromaticity may have changed anywhere in it.
+// The map indices are cleared as they're of no further use.
+void TautEnum::distances_from_edit( OEMolBase &mol , vector<int> &dists ) const {
+
+  dists = vector<int>( mol.GetMaxAtomIdx() , -1 );
+
+  vector<OEAtomBase *> mapped_atoms;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+    mapped_atoms.push_back( atom );
+  }
+
+  deque<OEAtomBase *> to_do;
+  BOOST_FOREACH( OEAtomBase *atom , mapped_atoms ) {
+    atom->SetMapIdx( 0 );
+    if( -1 != dists[atom->GetIdx()] ) {
+      continue;
+    }
+    dists[atom->GetIdx()] = 0;
+    to_do.push_back( atom );
+    if( atom->IsInRing() ) {
+      deque<OEAtomBase *> ring_sys( 1 , atom );
+      while( !ring_sys.empty() ) {
+        OEAtomBase *ra = ring_sys.front();
+        ring_sys.pop_front();
+        for( OEIter<OEBondBase> bond = ra->GetBonds() ; bond ; ++bond ) {
+          OEAtomBase *nbr = bond->GetNbr( ra );
+          if( bond->IsInRing() && -1 == dists[nbr->GetIdx()] ) {
+            dists[nbr->GetIdx()] = 0;
+            to_do.push_back( nbr );
+            ring_sys.push_back( nbr );
           }
         }
       }
+    }
+  }
+
+  while( !to_do.empty() ) {
+    OEAtomBase *atom = to_do.front();
+    to_do.pop_front();
+    for( OEIter<OEAtomBase> nbr = atom->GetAtoms() ; nbr ; ++nbr ) {
+      if( -1 == dists[nbr->GetIdx()] ) {
+        dists[nbr->GetIdx()] = dists[atom->GetIdx()] + 1;
+        to_do.push_back( nbr );
+      }
+    }
+  }
+
+}
+
+// ************************************************************************************
+// Any match of the SMIRKS that the edit could have created must start within the
+// SMIRKS' radius of the edit, so try rooting the first pattern atom at each atom
+// in that range. If that's most of the molecule, it's quicker just to let the
+// libgen have a go.
+bool TautEnum::could_match_near_edit( size_t rule_num , OEMolBase &mol ,
+                                      const vector<int> &dists ) const {
+
+  if( rule_radii_[rule_num] < 0 || !rule_screens_[rule_num] ) {
+    return true;
+  }
+
+  vector<OEAtomBase *> roots;
+  unsigned int num_hvy = 0;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H == atom->GetAtomicNum() ) {
+      continue;
+    }
+    ++num_hvy;
+    int d = dists[atom->GetIdx()];
+    if( d >= 0 && d <= rule_radii_[rule_num] ) {
+      roots.push_back( atom );
+    }
+  }
+  if( 2 * roots.size() > num_hvy ) {
+    return true;
+  }
+
+  OESubSearch &subs = *rule_screens_[rule_num];
+  OEIter<OEQAtomBase> patt_atom = subs.GetPattern().GetQAtoms();
+  bool ret_val = false;
+  BOOST_FOREACH( OEAtomBase *root , roots ) {
+    subs.ClearConstraints();
+    subs.AddConstraint( OEMatchPairAtom( patt_atom , root ) );
+    if( subs.SingleMatch( mol ) ) {
+      ret_val = true;
+      break;
+    }
+  }
+  subs.ClearConstraints();
+
+  return ret_val;
+
+}
+
+// ************************************************************************************
+void TautEnum::match_by_tag( const vector<OEAtomBase *> &start_atoms ,
+                             OEMolBase &prod_mol , MatchedAtoms &matched ) const {
+
+  for( OEIter<OEAtomBase> atom = prod_mol.GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+    if( !atom->HasData( DACLIB::ATOM_INDEX_TAG ) ) {
+      matched.clear();
+      return;
+    }
+    unsigned int tag = atom->GetData<unsigned int>( DACLIB::ATOM_INDEX_TAG );
+    if( tag >= start_atoms.size() ) {
+      matched.clear();
+      return;
+    }
+    matched.push_back( make_pair( start_atoms[tag] , static_cast<OEAtomBase *>( atom ) ) );
+  }
+
+}
+
+// ************************************************************************************
+void TautEnum::libgen_match( const vector<OEAtomBase *> &start_atoms ,
+                             const OEMolBase &prod_mol ,
+                             vector<OEAtomBase *> &match ) const {
+
+  vector<pair<unsigned int,OEAtomBase *> > by_map;
+  for( OEIter<OEAtomBase> atom = prod_mol.GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+    if( !atom->HasData( DACLIB::ATOM_INDEX_TAG ) ) {
+      match.clear();
+      return;
+    }
+    unsigned int tag = atom->GetData<unsigned int>( DACLIB::ATOM_INDEX_TAG );
+    if( tag >= start_atoms.size() ) {
+      match.clear();
+      return;
+    }
+    by_map.push_back( make_pair( atom->GetMapIdx() , start_atoms[tag] ) );
+  }
+  sort( by_map.begin() , by_map.end() );
+
+  match.clear();
+  for( size_t i = 0 , is = by_map.size() ; i < is ; ++i ) {
+    match.push_back( by_map[i].second );
+  }
+
+}
+
+// ************************************************************************************
+// The old way of relating the atoms, for when the tags haven't survived. The
+// libgen leaves the map indices of the last match on start_mol, which may not
+// be the one that made prod_mol, so this isn't to be trusted for radicals.
+void TautEnum::match_by_map_idx( OEMolBase &start_mol , OEMolBase &prod_mol ,
+                                 MatchedAtoms &matched ) const {
+
+  vector<OEAtomBase *> prod_by_map;
+  for( OEIter<OEAtomBase> atom = prod_mol.GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+    if( atom->GetMapIdx() >= prod_by_map.size() ) {
+      prod_by_map.resize( atom->GetMapIdx() + 1 , static_cast<OEAtomBase *>( 0 ) );
+    }
+    prod_by_map[atom->GetMapIdx()] = atom;
+  }
+  for( OEIter<OEAtomBase> atom = start_mol.GetAtoms( OEHasMapIdx() ) ; atom ; ++atom ) {
+    if( atom->GetMapIdx() < prod_by_map.size() && prod_by_map[atom->GetMapIdx()] ) {
+      matched.push_back( make_pair( static_cast<OEAtomBase *>( atom ) ,
+                                    prod_by_map[atom->GetMapIdx()] ) );
+    }
+  }
+
+}
+
+// ************************************************************************************
+// remove any stereochemistry from atoms affected by the reaction
+// start_mol is the starting material the product was made from, for its name.
+void TautEnum::remove_altered_stereochem( OEMolBase &start_mol , const MatchedAtoms &matched ) {
+
+  // fix atom stereo
+  for( size_t i = 0 , is = matched.size() ; i < is ; ++i ) {
+    OEAtomBase *atom = matched[i].first;
+    OEAtomBase *patom = matched[i].second;
+    if( atom->HasStereoSpecified() && patom->HasStereoSpecified( OEAtomStereo::Tetra ) ) {
+      if( atom->GetAtomicNum() != patom->GetAtomicNum() ||
+          atom->GetDegree() != patom->GetDegree() ||
+          atom->GetHvyDegree() != patom->GetHvyDegree() ||
+          atom->GetValence() != patom->GetValence() ||
+          atom->GetHvyDegree() != patom->GetHvyDegree() ||
+          atom->GetHyb() != patom->GetHyb() ||
+          atom->GetTotalHCount() != patom->GetTotalHCount() ) {
+        patom->SetStereo( vector<OEAtomBase *>() , OEAtomStereo::Tetra , OEAtomStereo::Undefined );
+        cout << "Stereochem removed for tautomer of " << start_mol.GetTitle() << endl;
+      }
+    }
+  }
 #ifdef NOTYET
-      // fix bond stereo - doesn't seem to be required, but might as well leave the
-      // testing code that established this, just in case.
-      for( OEIter<OEBondBase> bond = sms->GetBonds() ; bond ; ++bond ) {
-        if( bond->GetBgn()->GetMapIdx() && bond->GetEnd()->GetMapIdx() ) {
-          cout << "Bond between mapped atoms " << bond->GetBgn()->GetIdx() << " , " << bond->GetBgn()->GetMapIdx()
-               << " and " << bond->GetEnd()->GetIdx() << " , " << bond->GetEnd()->GetMapIdx() << endl;
-          cout << "Stereo specified : " << bond->HasStereoSpecified( OEBondStereo::CisTrans ) << endl;
-          OEAtomBase *pab = mol->GetAtom( OEHasMapIdx( bond->GetBgn()->GetMapIdx() ) );
-          OEAtomBase *pae = mol->GetAtom( OEHasMapIdx( bond->GetEnd()->GetMapIdx() ) );
-          if( pab && pae ) {
-            OEBondBase *pbond = mol->GetBond( pab , pae );
-            if( pbond ) {
-              cout << "P bond stereo : " << pbond->HasStereoSpecified( OEBondStereo::CisTrans ) << endl;
-            } else {
-              cout << "No product bond" << endl;
-            }
-          }
+  // fix bond stereo - doesn't seem to be required, but might as well leave the
+  // testing code that established this, just in case.
+  for( OEIter<OEBondBase> bond = start_mol.GetBonds() ; bond ; ++bond ) {
+    if( bond->GetBgn()->GetMapIdx() && bond->GetEnd()->GetMapIdx() ) {
+      cout << "Bond between mapped atoms " << bond->GetBgn()->GetIdx() << " , " << bond->GetBgn()->GetMapIdx()
+           << " and " << bond->GetEnd()->GetIdx() << " , " << bond->GetEnd()->GetMapIdx() << endl;
+      cout << "Stereo specified : " << bond->HasStereoSpecified( OEBondStereo::CisTrans ) << endl;
+      OEAtomBase *pab = mol->GetAtom( OEHasMapIdx( bond->GetBgn()->GetMapIdx() ) );
+      OEAtomBase *pae = mol->GetAtom( OEHasMapIdx( bond->GetEnd()->GetMapIdx() ) );
+      if( pab && pae ) {
+        OEBondBase *pbond = mol->GetBond( pab , pae );
+        if( pbond ) {
+          cout << "P bond stereo : " << pbond->HasStereoSpecified( OEBondStereo::CisTrans ) << endl;
+        } else {
+          cout << "No product bond" << endl;
         }
       }
+    }
+  }
 #endif
+
+}
+
+// ****************************************************************************
+// Tautomers that keep their aromaticity, and don't separate charges, are
+// the more likely ones.
+pair<int,int> tautomer_score( const OEMolBase &mol ) {
+
+  int num_arom = 0 , num_charged = 0;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( atom->IsAromatic() ) {
+      ++num_arom;
+    }
+    if( atom->GetFormalCharge() ) {
+      ++num_charged;
+    }
+  }
+
+  return make_pair( -num_arom , num_charged );
+
+}
+
+// ****************************************************************************
+// Tautomers have the same atoms, hydrogens included, the same net charge and
+// the same heavy atom skeleton. The skeleton is only compared if both have a
+// key, which they mostly will.
+bool tautomer_invariants_differ( const OEMolBase &mol_a , const OEMolBase &mol_b ) {
+
+  map<pair<unsigned int,unsigned int>,unsigned int> formula_a , formula_b;
+  int charge_a = 0 , charge_b = 0;
+  for( OEIter<OEAtomBase> atom = mol_a.GetAtoms() ; atom ; ++atom ) {
+    // the hydrogens are counted on the heavy atoms
+    if( OEElemNo::H != atom->GetAtomicNum() ) {
+      ++formula_a[make_pair( atom->GetAtomicNum() , atom->GetIsotope() )];
+      formula_a[make_pair( 1U , 0U )] += atom->GetTotalHCount();
     }
+    charge_a += atom->GetFormalCharge();
   }
+  for( OEIter<OEAtomBase> atom = mol_b.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H != atom->GetAtomicNum() ) {
+      ++formula_b[make_pair( atom->GetAtomicNum() , atom->GetIsotope() )];
+      formula_b[make_pair( 1U , 0U )] += atom->GetTotalHCount();
+    }
+    charge_b += atom->GetFormalCharge();
+  }
+  if( charge_a != charge_b || formula_a != formula_b ) {
+    return true;
+  }
+
+  string key_a , key_b;
+  if( DACLIB::skeleton_connectivity_key( mol_a , key_a ) &&
+      DACLIB::skeleton_connectivity_key( mol_b , key_b ) && key_a != key_b ) {
+    return true;
+  }
+
+  return false;
 
 }
 
@@ -332,10 +1342,9 @@ void TautEnum::remove_altered_stereochem( pOELibGen &libgen , OEMolBase *mol ) {
 void create_smiles( vector<OEMolBase *> &all_mols ,
                     vector<pair<string,OEMolBase *> > &smiles ) {
 
+  // the enumerated molecules already have them, from the deduplication
   BOOST_FOREACH( OEMolBase *mol , all_mols ) {
-    string smi;
-    OECreateSmiString( smi , *mol , OESMILESFlag::Canonical | OESMILESFlag::AtomStereo | OESMILESFlag::BondStereo );
-    smiles.push_back( make_pair( smi , mol ) );
+    smiles.push_back( make_pair( DACLIB::tagged_cansmi( *mol ) , mol ) );
   }
 
   sort( smiles.begin() , smiles.end() ,
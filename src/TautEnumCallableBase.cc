@@ -8,6 +8,12 @@
 #include "TautEnum.H"
 #include "TautStand.H"
 #include "TautEnumCallableBase.H"
+#include "GlobalDedup.H"
+#include "PassthroughScreen.H"
+#include "ProtonationCache.H"
+#include "ResultCache.H"
+#include "RunSummary.H"
+#include "SmilesWriter.H"
 #include "FileExceptions.H"
 #include "taut_enum_default_vector_bindings.H"
 #include "taut_enum_default_standardise_smirks.H"
@@ -17,6 +23,7 @@
 #include "taut_enum_protonate_b.H"
 #include "taut_enum_protonate_vb.H"
 
+#include <boost/foreach.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
@@ -24,6 +31,8 @@
 
 #include <oechem.h>
 
+#include <set>
+#include <sstream>
 #include <vector>
 
 using namespace OEChem;
@@ -32,8 +41,21 @@ using namespace std;
 namespace DACLIB {
 void apply_daylight_aromatic_model( OEMolBase &mol );
 string create_cansmi( const OEMolBase &in_mol );
+void clear_cansmi_tag( OEMolBase &mol ); // in cansmi_tag.cc
+string tagged_cansmi( const OEMolBase &mol ); // in cansmi_tag.cc
+unsigned int split_molecule_components( const OEMolBase &mol ,
+                                        vector<OEMolBase *> &comps ); // in eponymous file
+double estimate_tautomer_count( const OEMolBase &mol , bool carbon_sites ,
+                                unsigned int &num_sites , unsigned int &num_regions ); // in eponymous file
 }
 
+extern string BUILD_TIME; // in build_time.cc
+
+// components up to this size are kept in the ComponentCache, which is
+// allowed up to MAX_COMP_CACHE of them.
+static const unsigned int MAX_CACHED_COMP_ATOMS = 12;
+static const size_t MAX_COMP_CACHE = 1000;
+
 // in canned_tautenum_routines.cc
 void prepare_molecule( OEMolBase &mol );
 
@@ -48,6 +70,7 @@ void TautEnumCallableBase::operator ()() {
   create_enumerator_objects( tes_.standardise_smirks_file() , tes_.enumerate_smirks_file() ,
                              tes_.vb_file() , DACLIB::STAND_SMIRKS , enum_smirks ,
                              DACLIB::VBS , taut_stand , taut_enum );
+  taut_enum->set_bounded( tes_.bounded_enumeration() );
 
   TautStand *prot_stand = 0;
   TautEnum *prot_enum = 0;
@@ -57,11 +80,42 @@ void TautEnumCallableBase::operator ()() {
                                DACLIB::SET_PROT_VB , prot_stand , prot_enum );
   }
 
+  // the molecules none of the SMIRKS can touch are written as they are
+  boost::shared_ptr<PassthroughScreen> screen;
+  if( !tes_.no_passthrough() ) {
+    screen.reset( new PassthroughScreen );
+    screen->add_smirks( taut_stand->expanded_smirks() );
+    if( !tes_.standardise_only() ) {
+      if( tes_.extended_enumeration() || tes_.original_enumeration() ) {
+        screen->add_smirks( taut_enum->expanded_smirks() );
+      }
+      if( prot_enum ) {
+        screen->add_smirks( prot_stand->expanded_smirks() );
+        screen->add_smirks( prot_enum->expanded_smirks() );
+      }
+    }
+  }
+
+  // titles with SMIRKS in them aren't stored
+  boost::shared_ptr<ResultCache> result_cache;
+  if( !tes_.result_cache_dir().empty() && !tes_.add_smirks_to_name() ) {
+    try {
+      result_cache.reset( new ResultCache( tes_.result_cache_dir() ,
+                                           result_cache_settings( taut_stand , taut_enum ,
+                                                                  prot_stand , prot_enum ) ) );
+    } catch( DACLIB::FileWriteOpenError &e ) {
+      cerr << e.what() << " Carrying on without the result cache." << endl;
+    }
+  }
+
+  ComponentCache comp_cache;
   OEMolBase *in_mol = OENewMolBase( OEMolBaseType::OEDefault );
   int mol_num = 0;
 
   while( read_next_molecule( *in_mol ) ) {
     ++mol_num;
+    // in case Clear() left the last one's
+    DACLIB::clear_cansmi_tag( *in_mol );
     if( tes_.verbose() ) {
       cout << "Processing " << in_mol->GetTitle() << " : " << DACLIB::create_cansmi( *in_mol ) << " (" << mol_num << ")"  << endl;
     }
@@ -71,100 +125,131 @@ void TautEnumCallableBase::operator ()() {
     if( tes_.verbose() ) {
       cout << "Pre-processed molecule : " <<  DACLIB::create_cansmi( *in_mol ) << endl;
     }
+    // the size of the job, from the input, as standardisation only moves
+    // the hydrogens about.
+    double taut_estimate = 0.0;
+    if( tes_.tautomer_estimate_limit() > 0.0 || !tes_.tautomer_estimate_tag().empty() ) {
+      unsigned int num_sites , num_regions;
+      taut_estimate = DACLIB::estimate_tautomer_count( *in_mol , tes_.extended_enumeration() ,
+                                                       num_sites , num_regions );
+      if( tes_.verbose() ) {
+        cout << "Estimated number of tautomers : " << taut_estimate << " from " << num_sites
+             << " sites in " << num_regions << " regions." << endl;
+      }
+    }
 
     vector<OEMolBase *> out_mols;
     OEMolBase *std_mol = 0;
-    if( taut_stand ) {
-      std_mol = taut_stand->standardise( *in_mol , tes_.verbose() ,
-                                         tes_.add_smirks_to_name() ,
-                                         tes_.strip_salts() );
-    } else {
-      std_mol = OENewMolBase( *in_mol , OEMolBaseType::OEDefault );
+    // if no SMIRKS can touch it, the answer is the molecule itself, which is
+    // then written out like any other.
+    bool passed_through = screen && passthrough_molecule( *in_mol , *screen );
+    if( passed_through ) {
+      out_mols.push_back( OENewMolBase( *in_mol , OEMolBaseType::OEDefault ) );
     }
-
-    if( !tes_.standardise_only() ) {
-      if( tes_.extended_enumeration() || tes_.original_enumeration() ) {
-        try {
-          vector<OEMolBase *> taut_mols = taut_enum->enumerate( *std_mol , tes_.verbose() ,
-                                                                tes_.add_smirks_to_name() );
-          out_mols.insert( out_mols.end() , taut_mols.begin() , taut_mols.end() );
-        } catch( TooManyOutMols &e ) {
-          // just leave it as the standardised molecule
-          cerr << "Maximum number of tautomers generated for " << in_mol->GetTitle() << " so none generated." << endl;
-          out_mols.push_back( OENewMolBase( *std_mol , OEMolBaseType::OEDefault ) );
-          if( tes_.add_smirks_to_name() ) {
-            string new_name = in_mol->GetTitle() + string( " __MAX_TAUTS__" );
-            out_mols.back()->SetTitle( new_name );
-          }
-        }
+    // the cache has the final answer, if it's been done before
+    string cache_smi;
+    bool from_cache = false;
+    // the cache doesn't keep names, so not for anything flagged in its name
+    bool cacheable = true;
+    if( result_cache && !passed_through ) {
+      cache_smi = result_cache_smiles( *in_mol );
+      from_cache = result_cache->find( cache_smi , in_mol->GetTitle() , out_mols );
+    }
+    if( !from_cache && !passed_through ) {
+      if( taut_stand ) {
+        std_mol = taut_stand->standardise( *in_mol , tes_.verbose() ,
+                                           tes_.add_smirks_to_name() ,
+                                           tes_.strip_salts() );
+      } else {
+        std_mol = OENewMolBase( *in_mol , OEMolBaseType::OEDefault );
       }
 
-      if( prot_enum ) {
-        if( out_mols.empty() ) {
-          // just doing an enumerate_protonation job. May need to do strip salts.
-          OEMolBase *std_prot_mol = prot_stand->standardise( *std_mol , tes_.verbose() ,
-                                                             tes_.add_smirks_to_name() ,
-                                                             true );
+      if( !tes_.standardise_only() ) {
+        if( tes_.extended_enumeration() || tes_.original_enumeration() ) {
           try {
-            vector<OEMolBase *> prot_mols = prot_enum->enumerate( *std_prot_mol , tes_.verbose() ,
-                                                                  tes_.add_smirks_to_name() );
-            out_mols.insert( out_mols.end() , prot_mols.begin() , prot_mols.end() );
+            if( tes_.tautomer_estimate_limit() > 0.0 && taut_estimate > tes_.tautomer_estimate_limit() ) {
+              // not worth starting
+              throw TooManyOutMols( *std_mol );
+            }
+            if( tes_.scored_canonical_tautomer() ) {
+              bool complete = true;
+              out_mols.push_back( taut_enum->canonical_tautomer( *std_mol , complete , tes_.verbose() ,
+                                                                 tes_.add_smirks_to_name() ) );
+              if( !complete ) {
+                // it's the best of those found, so may not be the same for
+                // another tautomer of the same molecule, and needs saying
+                // whether or not the SMIRKS are going in the name.
+                cerr << "Maximum number of tautomers searched for " << in_mol->GetTitle()
+                     << " so its canonical tautomer is the best of those found." << endl;
+                out_mols.back()->SetTitle( out_mols.back()->GetTitle() + string( " __MAX_TAUTS__" ) );
+                cacheable = false;
+              }
+            } else {
+              enumerate_tautomers( *std_mol , *taut_enum , comp_cache , out_mols );
+            }
           } catch( TooManyOutMols &e ) {
-            cerr << "Maximum number of ionisation states generated for " << in_mol->GetTitle() << " so none generated." << endl;
-            // just leave it as it was. I think it's pretty unlikely to happen.
-            std_prot_mol = 0;
-          }
-          delete std_prot_mol;
-        } else {
-          // in this case, we don't want to include the output from the tautomer enumeration
-          // in the output, but we do want to pass each tautomer through the protonation
-          // enumerator
-          vector<OEMolBase *> prot_out_mols;
-          for( size_t i = 0 , is = out_mols.size() ; i < is ; ++i ) {
-            // strip_salts will already have been applied by taut_stand if we wanted to do it,
-            // as all input mols are standardised.
-            OEMolBase *std_prot_mol = prot_stand->standardise( *out_mols[i] , tes_.verbose() ,
-                                                               tes_.add_smirks_to_name() ,
-                                                               false );
-            try {
-              vector<OEMolBase *> prot_mols = prot_enum->enumerate( *std_prot_mol , tes_.verbose() ,
-                                                                    tes_.add_smirks_to_name() );
-              prot_out_mols.insert( prot_out_mols.end() , prot_mols.begin() , prot_mols.end() );
-            } catch( TooManyOutMols &e ) {
-              cerr << "Maximum number of ionisation states generated for " << in_mol->GetTitle() << " tautomer " << i << " so none generated." << endl;
-              // just leave it as it was. I think it's pretty unlikely to happen.
+            // just leave it as the standardised molecule
+            cerr << "Maximum number of tautomers generated for " << in_mol->GetTitle() << " so none generated." << endl;
+            out_mols.push_back( OENewMolBase( *std_mol , OEMolBaseType::OEDefault ) );
+            if( tes_.add_smirks_to_name() ) {
+              string new_name = in_mol->GetTitle() + string( " __MAX_TAUTS__" );
+              out_mols.back()->SetTitle( new_name );
             }
-            delete std_prot_mol;
           }
-          // empty out_mols and replace with prot_out_mols
-          for( size_t i = 0 , is = out_mols.size() ; i < is ; ++i ) {
-            delete out_mols[i];
+        }
+
+        if( prot_enum ) {
+          if( out_mols.empty() ) {
+            // just doing an enumerate_protonation job. May need to do strip salts.
+            protonate_tautomers( *in_mol , vector<OEMolBase *>( 1 , std_mol ) , true ,
+                                 *prot_stand , *prot_enum , prot_cache_ , out_mols );
+          } else {
+            // in this case, we don't want to include the output from the tautomer enumeration
+            // in the output, but we do want to pass each tautomer through the protonation
+            // enumerator
+            vector<OEMolBase *> prot_out_mols;
+            if( !tes_.fused_protonation() ||
+                !fused_protonate_tautomers( *in_mol , out_mols , *prot_stand , *prot_enum , prot_out_mols ) ) {
+              protonate_tautomers( *in_mol , out_mols , false , *prot_stand , *prot_enum ,
+                                   prot_cache_ , prot_out_mols );
+            }
+            // empty out_mols and replace with prot_out_mols
+            for( size_t i = 0 , is = out_mols.size() ; i < is ; ++i ) {
+              delete out_mols[i];
+            }
+            out_mols = prot_out_mols;
           }
-          out_mols = prot_out_mols;
         }
-      }
-    } else {
+      } else {
 #ifdef NOTYET
-      cout << "standardise only" << endl;
+        cout << "standardise only" << endl;
 #endif
-      out_mols.push_back( OENewMolBase( *std_mol , OEMolBaseType::OEDefault ) );
+        out_mols.push_back( OENewMolBase( *std_mol , OEMolBaseType::OEDefault ) );
+      }
+
+      sort_and_uniquify_molecules( out_mols );
+      if( result_cache && cacheable ) {
+        result_cache->add( cache_smi , out_mols );
+      }
     }
 
-    sort_and_uniquify_molecules( out_mols );
+    if( !tes_.tautomer_estimate_tag().empty() ) {
+      string est = boost::lexical_cast<string>( taut_estimate );
+      BOOST_FOREACH( OEMolBase *out_mol , out_mols ) {
+        OESetSDData( *out_mol , tes_.tautomer_estimate_tag() , est );
+      }
+    }
 
     if( tes_.include_input_in_output() ) {
-      write_molecule( *in_mol );
+      emit_molecule( *in_mol );
     }
-    if( tes_.canonical_tautomer() ) {
+    if( tes_.canonical_tautomer() || tes_.scored_canonical_tautomer() ) {
       if( out_mols.empty() ) {
         // probably hit the exception for too many tautomers, so write standardised input mol
         out_mols.push_back( OENewMolBase( *std_mol , OEMolBaseType::OEDefault ) );
       }
-      if( tes_.add_numbers_to_name() ) {
-        // it's not very sensible, but the user might ask for it
-        out_mols.front()->SetTitle( out_mols.front()->GetTitle() + tes_.name_postfix() + string( "1" ) );
-      }
-      write_molecule( *out_mols.front() );
+      vector<OEMolBase *> canon_mol( 1 , out_mols.front() );
+      output_molecules( canon_mol );
     } else {
       output_molecules( out_mols );
     }
@@ -179,6 +264,16 @@ void TautEnumCallableBase::operator ()() {
     delete std_mol;
   }
 
+  if( run_summary_ ) {
+    if( screen ) {
+      run_summary_->add_passthrough( screen->num_tested() , screen->num_passed() );
+    }
+    if( result_cache ) {
+      run_summary_->add_result_cache( result_cache->hits() , result_cache->misses() ,
+                                      result_cache->adds() , result_cache->dir() );
+    }
+  }
+
   // give it time to clear up properly
   boost::this_thread::sleep( boost::posix_time::seconds( 1 ) );
   delete in_mol;
@@ -189,6 +284,279 @@ void TautEnumCallableBase::operator ()() {
 
 }
 
+// ****************************************************************************
+// everything that affects the output for a given input molecule, for the
+// ResultCache. That includes the program itself, as a change to the code or
+// the toolkit can change the answers, so a rebuild starts a fresh cache.
+string TautEnumCallableBase::result_cache_settings( const TautStand *taut_stand ,
+                                                    const TautEnum *taut_enum ,
+                                                    const TautStand *prot_stand ,
+                                                    const TautEnum *prot_enum ) const {
+
+  typedef pair<string,string> VB;
+  ostringstream oss;
+  oss << "built " << BUILD_TIME << endl
+      << "OEChem " << OEChemGetRelease() << " " << OEChemGetVersion() << endl
+      << "standardise_only " << tes_.standardise_only() << endl
+      << "original_enumeration " << tes_.original_enumeration() << endl
+      << "extended_enumeration " << tes_.extended_enumeration() << endl
+      << "enumerate_protonation " << tes_.enumerate_protonation() << endl
+      << "fused_protonation " << tes_.fused_protonation() << endl
+      << "strip_salts " << tes_.strip_salts() << endl
+      << "max_tautomers " << tes_.max_tautomers() << endl
+      << "tautomer_estimate_limit " << tes_.tautomer_estimate_limit() << endl
+      << "bounded_enumeration " << tes_.bounded_enumeration() << endl
+      << "scored_canonical_tautomer " << tes_.scored_canonical_tautomer() << endl
+      << "native_engine " << tes_.native_engine() << endl;
+  if( taut_stand ) {
+    oss << "Standardisation" << endl;
+    BOOST_FOREACH( const VB &vb , taut_stand->vector_bindings() ) {
+      oss << vb.first << " " << vb.second << endl;
+    }
+    BOOST_FOREACH( const string &smirks , taut_stand->expanded_smirks() ) {
+      oss << smirks << endl;
+    }
+  }
+  if( taut_enum ) {
+    oss << "Enumeration" << endl;
+    BOOST_FOREACH( const VB &vb , taut_enum->vector_bindings() ) {
+      oss << vb.first << " " << vb.second << endl;
+    }
+    BOOST_FOREACH( const string &smirks , taut_enum->expanded_smirks() ) {
+      oss << smirks << endl;
+    }
+  }
+  if( prot_stand ) {
+    oss << "Protonation standardisation" << endl;
+    BOOST_FOREACH( const VB &vb , prot_stand->vector_bindings() ) {
+      oss << vb.first << " " << vb.second << endl;
+    }
+    BOOST_FOREACH( const string &smirks , prot_stand->expanded_smirks() ) {
+      oss << smirks << endl;
+    }
+  }
+  if( prot_enum ) {
+    oss << "Protonation enumeration" << endl;
+    BOOST_FOREACH( const VB &vb , prot_enum->vector_bindings() ) {
+      oss << vb.first << " " << vb.second << endl;
+    }
+    BOOST_FOREACH( const string &smirks , prot_enum->expanded_smirks() ) {
+      oss << smirks << endl;
+    }
+  }
+
+  return oss.str();
+
+}
+
+// ****************************************************************************
+// If none of the SMIRKS can match in_mol, the output would just be in_mol
+// again. It should have been through prepare_molecule, so it's the same as
+// standardising it would give. The salts would be stripped from a
+// multi-component molecule, which needs the full treatment.
+bool TautEnumCallableBase::passthrough_molecule( OEMolBase &in_mol ,
+                                                 PassthroughScreen &screen ) {
+
+  if( tes_.strip_salts() || tes_.enumerate_protonation() ) {
+    vector<unsigned int> parts( in_mol.GetMaxAtomIdx() , 0 );
+    if( OEDetermineComponents( in_mol , &parts[0] ) > 1 ) {
+      return false;
+    }
+  }
+  OEAssignAromaticFlags( in_mol );
+  if( !screen.passes( in_mol ) ) {
+    return false;
+  }
+  if( tes_.verbose() ) {
+    cout << "No SMIRKS matches " << in_mol.GetTitle() << " so it is passed through." << endl;
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+// Multi-component records, salts and solvates mostly, are enumerated a
+// component at a time, so the counterions aren't carried through every rule
+// match and copy, and their tautomers, if any, are remembered. The answer is
+// the same as enumerating the whole thing, as the SMIRKS can't span
+// components. With add_smirks_to_name, the names would be different, so it's
+// done the old way.
+void TautEnumCallableBase::enumerate_tautomers( OEMolBase &std_mol , TautEnum &taut_enum ,
+                                                ComponentCache &comp_cache ,
+                                                vector<OEMolBase *> &taut_mols ) {
+
+  vector<OEMolBase *> comps;
+  // a bounded enumeration has to see all the tautomers to pick the best
+  if( tes_.whole_molecule_enumeration() || tes_.add_smirks_to_name() ||
+      tes_.bounded_enumeration() ||
+      DACLIB::split_molecule_components( std_mol , comps ) < 2 ) {
+    vector<OEMolBase *> these_mols = taut_enum.enumerate( std_mol , tes_.verbose() ,
+                                                          tes_.add_smirks_to_name() );
+    taut_mols.insert( taut_mols.end() , these_mols.begin() , these_mols.end() );
+    return;
+  }
+
+  typedef boost::shared_ptr<OEMolBase> pOEMolBase;
+  vector<vector<pOEMolBase> > comp_tauts;
+  size_t num_combs = 1;
+  bool too_many = false;
+  BOOST_FOREACH( OEMolBase *comp , comps ) {
+    DACLIB::clear_cansmi_tag( *comp );
+    OEFindRingAtomsAndBonds( *comp );
+    OEAssignAromaticFlags( *comp );
+    OEPerceiveChiral( *comp );
+    string comp_smi = DACLIB::create_cansmi( *comp );
+    ComponentCache::iterator p = comp_cache.find( comp_smi );
+    if( comp_cache.end() != p ) {
+      comp_tauts.push_back( p->second );
+    } else {
+      try {
+        vector<OEMolBase *> these_mols = taut_enum.enumerate( *comp , tes_.verbose() , false );
+        comp_tauts.push_back( vector<pOEMolBase>( these_mols.begin() , these_mols.end() ) );
+      } catch( TooManyOutMols &e ) {
+        too_many = true;
+        break;
+      }
+      if( comp->NumAtoms() <= MAX_CACHED_COMP_ATOMS && comp_cache.size() < MAX_COMP_CACHE ) {
+        comp_cache.insert( make_pair( comp_smi , comp_tauts.back() ) );
+      }
+    }
+    num_combs *= comp_tauts.back().size();
+    if( num_combs > taut_enum.max_out_mols() ) {
+      too_many = true;
+      break;
+    }
+  }
+  BOOST_FOREACH( OEMolBase *comp , comps ) {
+    delete comp;
+  }
+  if( too_many ) {
+    throw TooManyOutMols( std_mol );
+  }
+
+  // put them back together, every tautomer of each component with every one
+  // of all the others.
+  vector<size_t> counter( comp_tauts.size() , 0 );
+  while( true ) {
+    OEMolBase *taut_mol = OENewMolBase( OEMolBaseType::OEDefault );
+    for( size_t i = 0 , is = comp_tauts.size() ; i < is ; ++i ) {
+      OEAddMols( *taut_mol , *comp_tauts[i][counter[i]] );
+    }
+    OEFindRingAtomsAndBonds( *taut_mol );
+    OEAssignAromaticFlags( *taut_mol );
+    OEPerceiveChiral( *taut_mol );
+    taut_mol->SetTitle( std_mol.GetTitle() );
+    taut_mols.push_back( taut_mol );
+    size_t j = 0;
+    for( ; j < counter.size() ; ++j ) {
+      if( ++counter[j] < comp_tauts[j].size() ) {
+        break;
+      }
+      counter[j] = 0;
+    }
+    if( j == counter.size() ) {
+      break;
+    }
+  }
+
+}
+
+// ****************************************************************************
+void TautEnumCallableBase::protonate_tautomers( OEMolBase &in_mol ,
+                                                const vector<OEMolBase *> &taut_mols ,
+                                                bool strip_salts ,
+                                                TautStand &prot_stand , TautEnum &prot_enum ,
+                                                ProtonationCache *prot_cache ,
+                                                vector<OEMolBase *> &prot_mols ) {
+
+  set<string> std_smis;
+  for( size_t i = 0 , is = taut_mols.size() ; i < is ; ++i ) {
+    // strip_salts will already have been applied by taut_stand if we wanted to do it,
+    // as all input mols are standardised.
+    OEMolBase *std_prot_mol = prot_stand.standardise( *taut_mols[i] , tes_.verbose() ,
+                                                      tes_.add_smirks_to_name() ,
+                                                      strip_salts );
+    string std_smi = DACLIB::tagged_cansmi( *std_prot_mol );
+    if( !std_smis.insert( std_smi ).second ) {
+      // it'll give the same as an earlier tautomer
+      if( prot_cache ) {
+        prot_cache->add_duplicate();
+      }
+      delete std_prot_mol;
+      continue;
+    }
+    bool too_many = false;
+    if( !prot_cache || !prot_cache->find( std_smi , std_prot_mol->GetTitle() , prot_mols , too_many ) ) {
+      try {
+        vector<OEMolBase *> these_mols = prot_enum.enumerate( *std_prot_mol , tes_.verbose() ,
+                                                              tes_.add_smirks_to_name() );
+        if( prot_cache ) {
+          prot_cache->add( std_smi , these_mols , false );
+        }
+        prot_mols.insert( prot_mols.end() , these_mols.begin() , these_mols.end() );
+      } catch( TooManyOutMols &e ) {
+        too_many = true;
+        if( prot_cache ) {
+          prot_cache->add( std_smi , vector<OEMolBase *>() , true );
+        }
+      }
+    }
+    if( too_many ) {
+      cerr << "Maximum number of ionisation states generated for " << in_mol.GetTitle() << " tautomer " << i << " so none generated." << endl;
+      // just leave it as it was. I think it's pretty unlikely to happen.
+    }
+    delete std_prot_mol;
+  }
+
+}
+
+// ****************************************************************************
+// Many tautomers standardise to the same protonation state, and the protonation
+// states of different tautomers overlap, so rather than enumerating from each
+// and removing the duplicates at the end, enumerate once from the distinct
+// standardised states, with the one set of SMILES to check products against.
+// The result is the same unless max_tautomers is exceeded, which is applied
+// to the total here, so the caller should then do it the long way.
+bool TautEnumCallableBase::fused_protonate_tautomers( OEMolBase &in_mol ,
+                                                      const vector<OEMolBase *> &taut_mols ,
+                                                      TautStand &prot_stand , TautEnum &prot_enum ,
+                                                      vector<OEMolBase *> &prot_mols ) {
+
+  set<string> std_smis;
+  vector<OEMolBase *> std_prot_mols;
+  BOOST_FOREACH( OEMolBase *taut_mol , taut_mols ) {
+    OEMolBase *std_prot_mol = prot_stand.standardise( *taut_mol , tes_.verbose() ,
+                                                      tes_.add_smirks_to_name() ,
+                                                      false );
+    if( std_smis.insert( DACLIB::tagged_cansmi( *std_prot_mol ) ).second ) {
+      std_prot_mols.push_back( std_prot_mol );
+    } else {
+      delete std_prot_mol;
+    }
+  }
+
+  bool ret_val = true;
+  try {
+    set<string> all_can_smis;
+    prot_mols = prot_enum.enumerate( std_prot_mols , all_can_smis , tes_.verbose() ,
+                                     tes_.add_smirks_to_name() );
+  } catch( TooManyOutMols &e ) {
+    if( tes_.verbose() ) {
+      cout << "Too many ionisation states in total for " << in_mol.GetTitle()
+           << ", enumerating from each tautomer separately." << endl;
+    }
+    ret_val = false;
+  }
+
+  BOOST_FOREACH( OEMolBase *std_prot_mol , std_prot_mols ) {
+    delete std_prot_mol;
+  }
+
+  return ret_val;
+
+}
+
 // ****************************************************************************
 // make the TautStand and TautEnum objects, using the relevant data from tes_
 void TautEnumCallableBase::create_enumerator_objects( const string &stand_smirks_file ,
@@ -236,6 +604,7 @@ void TautEnumCallableBase::create_enumerator_objects( const string &stand_smirks
 #endif
     taut_enum = new TautEnum( default_enum_smirks , default_vbs , tes_.max_tautomers() );
   }
+  taut_enum->set_native_engine( tes_.native_engine() );
 
 }
 
@@ -243,10 +612,25 @@ void TautEnumCallableBase::create_enumerator_objects( const string &stand_smirks
 void TautEnumCallableBase::output_molecules( vector<OEMolBase *> &out_mols ) {
 
   for( size_t i = 0 , is = out_mols.size() ; i < is ; ++i ) {
+    if( global_dedup_ && !global_dedup_->add( DACLIB::tagged_cansmi( *out_mols[i] ) ,
+                                              out_mols[i]->GetTitle() ) ) {
+      continue;
+    }
     if( tes_.add_numbers_to_name() ) {
       out_mols[i]->SetTitle( out_mols[i]->GetTitle() + tes_.name_postfix() + boost::lexical_cast<string>( i + 1 ) );
     }
-    write_molecule( *out_mols[i] );
+    emit_molecule( *out_mols[i] );
+  }
+
+}
+
+// ****************************************************************************
+void TautEnumCallableBase::emit_molecule( OEMolBase &mol ) {
+
+  if( smiles_writer_ ) {
+    smiles_writer_->write( mol );
+  } else {
+    write_molecule( mol );
   }
 
 }
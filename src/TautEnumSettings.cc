@@ -22,9 +22,14 @@ TautEnumSettings::TautEnumSettings( int argc , char **argv ) :
   name_postfix_( "_" ) , standardise_only_( true ) ,
   orig_enumeration_( false ) , extended_enumeration_( false ) ,
   add_numbers_to_name_( false ) , add_smirks_to_name_( false ) ,
-  canon_taut_( false ) , enum_protonation_( false ) ,
+  canon_taut_( false ) , scored_canon_taut_( false ) , enum_protonation_( false ) ,
   inc_input_in_output_( false ) , strip_salts_( false ) , max_tauts_( 256 ) ,
-  do_threaded_( false ) , num_threads_( -1 ) , verbose_( false ) {
+  do_threaded_( false ) , num_threads_( -1 ) , verbose_( false ) ,
+  native_engine_( false ) , fused_protonation_( false ) ,
+  prot_cache_size_( 10000 ) , whole_mol_enumeration_( false ) ,
+  no_passthrough_( false ) , global_dedup_( false ) ,
+  global_dedup_memory_( 512 ) , oechem_smiles_writer_( false ) ,
+  taut_estimate_limit_( 0.0 ) , bounded_enumeration_( false ) {
 
   po::options_description desc( "Allowed Options" );
   build_program_options( desc );
@@ -69,7 +74,11 @@ bool TautEnumSettings::operator!() const {
     error_msg_ = "You can't have both original and extended enumerations.";
     return true;
   }
-  if( include_input_in_output() && canonical_tautomer() ) {
+  if( canonical_tautomer() && scored_canonical_tautomer() ) {
+    error_msg_ = "You can't have both canonical tautomer and scored canonical tautomer.";
+    return true;
+  }
+  if( include_input_in_output() && ( canonical_tautomer() || scored_canonical_tautomer() ) ) {
     error_msg_ = "You can't have both canonical tautomer and include input in output.";
     return true;
   }
@@ -81,6 +90,10 @@ bool TautEnumSettings::operator!() const {
     error_msg_ = "You must specify an output molecule file.";
     return true;
   }
+  if( global_dedup_ && global_dedup_map_file_.empty() ) {
+    error_msg_ = "You must specify a mapping file for --global-dedup.";
+    return true;
+  }
 
   return false;
 
@@ -121,6 +134,8 @@ void TautEnumSettings::build_program_options( po::options_description &desc ) {
         "Add to the name a space-separated list of the SMIRKS names that were used to generate this tautomer from the input structure." )
       ( "canonical-tautomer" , po::value<bool>( &canon_taut_ )->zero_tokens() ,
         "Just output the canonical tautomer of each molecule." )
+      ( "scored-canonical-tautomer" , po::value<bool>( &scored_canon_taut_ )->zero_tokens() ,
+        "Just output a canonical tautomer of each molecule defined as the most aromatic, then least charged, tautomer, with ties broken by SMILES. It gives an answer for molecules with more than max-tautomers of them, but then it's only the best of those found, and __MAX_TAUTS__ is added to the name." )
       ( "include-input-in-output" , po::value<bool>( &inc_input_in_output_ )->zero_tokens() ,
         "Before each set of tautomers is output, write the input molecule as it came in.")
       ( "strip-salts" , po::value<bool>( &strip_salts_)->zero_tokens() ,
@@ -134,6 +149,34 @@ void TautEnumSettings::build_program_options( po::options_description &desc ) {
       ( "verbose" , po::value<bool>( &verbose_ )->zero_tokens() ,
         "Extra output saying what's been going on." )
       ( "warm-feeling,W" , po::value<bool>( &verbose_ )->zero_tokens() ,
-        "Extra output saying what's been going on." );
+        "Extra output saying what's been going on." )
+      ( "native-engine" , po::value<bool>( &native_engine_ )->zero_tokens() ,
+        "Experimental, not yet checked against OELibraryGen by test_dir/compare_engines.sh. Apply the simpler enumeration SMIRKS with the built-in matcher rather than OELibraryGen." )
+      ( "fused-protonation" , po::value<bool>( &fused_protonation_ )->zero_tokens() ,
+        "With --enumerate-protonation, enumerate the protonation states of all the tautomers in one go, rather than each separately." )
+      ( "protonation-cache-size" , po::value<unsigned int>( &prot_cache_size_ ) ,
+        "Number of standardised protonation states to remember the enumerations of. Defaults to 10000, 0 turns it off." )
+      ( "whole-molecule-enumeration" , po::value<bool>( &whole_mol_enumeration_ )->zero_tokens() ,
+        "Enumerate multi-component molecules in one go, rather than a component at a time." )
+      ( "no-passthrough" , po::value<bool>( &no_passthrough_ )->zero_tokens() ,
+        "Process every molecule fully, even those that none of the SMIRKS can match, rather than writing them out unchanged." )
+      ( "global-dedup" , po::value<bool>( &global_dedup_ )->zero_tokens() ,
+        "Write each distinct output molecule only once in the whole run, recording the input molecules it came from in the mapping file." )
+      ( "global-dedup-mapping-file" , po::value<string>( &global_dedup_map_file_ ) ,
+        "File for --global-dedup to write the SMILES, input name and whether it was written for each output molecule." )
+      ( "global-dedup-memory" , po::value<unsigned int>( &global_dedup_memory_ ) ,
+        "Memory in MB for --global-dedup to use before spilling to disk. Defaults to 512." )
+      ( "global-dedup-spill-dir" , po::value<string>( &global_dedup_spill_dir_ ) ,
+        "Directory for --global-dedup spill files. Defaults to the system temporary directory." )
+      ( "result-cache-dir" , po::value<string>( &result_cache_dir_ ) ,
+        "Directory for a cache of results that persists between runs, so molecules done before with the same SMIRKS and settings, by the same build of the program, needn't be done again. It can be shared by jobs running at the same time." )
+      ( "oechem-smiles-writer" , po::value<bool>( &oechem_smiles_writer_ )->zero_tokens() ,
+        "Write SMILES output files with the OEChem writer rather than taut_enum's own, which for .ism files uses the canonical SMILES already made for each molecule." )
+      ( "tautomer-estimate-limit" , po::value<double>( &taut_estimate_limit_ ) ,
+        "Don't enumerate the tautomers of molecules estimated to have more than this many, but treat them as if there had been too many. The estimate is rough, so this should be well above max-tautomers. Default 0 means no limit." )
+      ( "tautomer-estimate-tag" , po::value<string>( &taut_estimate_tag_ ) ,
+        "SD tag to write each molecule's estimated number of tautomers into." )
+      ( "bounded-enumeration" , po::value<bool>( &bounded_enumeration_ )->zero_tokens() ,
+        "When a molecule has more than max-tautomers tautomers, explore them best first, preferring aromatic and uncharged ones, and output the best max-tautomers of them instead of just the standardised molecule." );
 
 }
@@ -0,0 +1,41 @@
+//
+// file TautGraph.cc
+// agent
+// 18th October 2026
+//
+
+#include "TautGraph.H"
+
+#include <oechem.h>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+// ****************************************************************************
+TautGraph::TautGraph( const OEMolBase &mol ) {
+
+  // GetIdx() numbers can have gaps, so map them onto our own.
+  vector<int> graph_idx( mol.GetMaxAtomIdx() , -1 );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    graph_idx[atom->GetIdx()] = static_cast<int>( atoms_.size() );
+    atoms_.push_back( atom );
+    atomic_num_.push_back( atom->GetAtomicNum() );
+    formal_charge_.push_back( atom->GetFormalCharge() );
+    aromatic_.push_back( atom->IsAromatic() );
+    imp_h_count_.push_back( atom->GetImplicitHCount() );
+    tot_h_count_.push_back( atom->GetTotalHCount() );
+  }
+
+  nbr_start_.reserve( atoms_.size() + 1 );
+  for( size_t i = 0 , is = atoms_.size() ; i < is ; ++i ) {
+    nbr_start_.push_back( static_cast<unsigned int>( nbrs_.size() ) );
+    for( OEIter<OEBondBase> bond = atoms_[i]->GetBonds() ; bond ; ++bond ) {
+      nbrs_.push_back( static_cast<unsigned int>( graph_idx[bond->GetNbr( atoms_[i] )->GetIdx()] ) );
+      bond_order_.push_back( bond->GetOrder() );
+      bond_aromatic_.push_back( bond->IsAromatic() );
+    }
+  }
+  nbr_start_.push_back( static_cast<unsigned int>( nbrs_.size() ) );
+
+}
@@ -0,0 +1,151 @@
+//
+// file TautIndex.cc
+// agent
+// 18th October 2026
+//
+
+#include "TautIndex.H"
+#include "FileExceptions.H"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+namespace DACLIB {
+void hash_smiles_128( const string &smiles , boost::uint64_t &hi ,
+                      boost::uint64_t &lo ); // in eponymous file
+}
+
+static const char MAGIC[] = "TAUTIDX1";
+
+// ****************************************************************************
+TautIndex::TautIndex( const string &filename ) {
+
+  try {
+    file_.open( filename );
+  } catch( ios_base::failure &e ) {
+    throw DACLIB::FileReadOpenError( filename.c_str() );
+  }
+  if( !file_.is_open() || file_.size() < HEADER_SIZE * sizeof( boost::uint64_t ) ||
+      strncmp( file_.data() , MAGIC , 8 ) ) {
+    throw DACLIB::FileReadOpenError( filename.c_str() );
+  }
+
+  // the layout is fixed by the header, so check it all fits in the file
+  // before lookup trusts any of it. Done as divisions so that a corrupt
+  // header can't overflow the sums.
+  boost::uint64_t file_words = file_.size() / sizeof( boost::uint64_t );
+  boost::uint64_t num_slots = header( NUM_SLOTS );
+  boost::uint64_t num_ids = header( NUM_IDS );
+  if( num_slots < 2 || ( num_slots & ( num_slots - 1 ) ) ||
+      header( NUM_ENTRIES ) >= num_slots ||
+      num_slots > ( file_words - HEADER_SIZE ) / 3 ||
+      header( IDS_OFFSET ) != ( HEADER_SIZE + 3 * num_slots ) * sizeof( boost::uint64_t ) ||
+      num_ids > file_words - HEADER_SIZE - 3 * num_slots ||
+      header( STRINGS_OFFSET ) != header( IDS_OFFSET ) + num_ids * sizeof( boost::uint64_t ) ||
+      header( STRINGS_OFFSET ) > file_.size() ) {
+    throw DACLIB::FileReadOpenError( filename.c_str() );
+  }
+  // each id is null-terminated, so if the last one is, none can run off
+  // the end of the file.
+  if( num_ids && ( file_.size() == header( STRINGS_OFFSET ) ||
+                   file_.data()[file_.size() - 1] ) ) {
+    throw DACLIB::FileReadOpenError( filename.c_str() );
+  }
+
+}
+
+// ****************************************************************************
+void TautIndex::lookup( const string &smiles , vector<string> &ids ) const {
+
+  boost::uint64_t hi , lo;
+  DACLIB::hash_smiles_128( smiles , hi , lo );
+
+  boost::uint64_t num_slots = header( NUM_SLOTS );
+  boost::uint64_t num_ids = header( NUM_IDS );
+  const boost::uint64_t *sl = slots();
+  const boost::uint64_t *id_offsets = reinterpret_cast<const boost::uint64_t *>( file_.data() + header( IDS_OFFSET ) );
+  const char *strings = file_.data() + header( STRINGS_OFFSET );
+  boost::uint64_t strings_size = file_.size() - header( STRINGS_OFFSET );
+
+  // num_slots is a power of 2, and there's always an empty one if the file
+  // was written by write(). The slots themselves weren't checked on opening,
+  // so don't go round more than once, and skip any entry that points outside
+  // the file.
+  boost::uint64_t i = hi & ( num_slots - 1 );
+  for( boost::uint64_t j = 0 ; j < num_slots ; ++j , i = ( i + 1 ) & ( num_slots - 1 ) ) {
+    const boost::uint64_t *slot = sl + 3 * i;
+    if( !slot[2] ) {
+      break;
+    }
+    if( slot[2] > num_ids || id_offsets[slot[2] - 1] >= strings_size ) {
+      continue;
+    }
+    if( slot[0] == hi && slot[1] == lo ) {
+      string id( strings + id_offsets[slot[2] - 1] );
+      if( ids.end() == find( ids.begin() , ids.end() , id ) ) {
+        ids.push_back( id );
+      }
+    }
+  }
+
+}
+
+// ****************************************************************************
+void TautIndex::write( const string &filename , const vector<Entry> &entries ,
+                       const vector<string> &ids ) {
+
+  // at least half empty, so probe sequences stay short
+  boost::uint64_t num_slots = 2;
+  while( num_slots < 2 * entries.size() ) {
+    num_slots *= 2;
+  }
+  vector<boost::uint64_t> slots( 3 * num_slots , 0 );
+  BOOST_FOREACH( const Entry &entry , entries ) {
+    boost::uint64_t i = entry.hi_ & ( num_slots - 1 );
+    while( slots[3 * i + 2] ) {
+      i = ( i + 1 ) & ( num_slots - 1 );
+    }
+    slots[3 * i] = entry.hi_;
+    slots[3 * i + 1] = entry.lo_;
+    slots[3 * i + 2] = entry.id_num_ + 1;
+  }
+
+  vector<boost::uint64_t> id_offsets;
+  boost::uint64_t next_offset = 0;
+  BOOST_FOREACH( const string &id , ids ) {
+    id_offsets.push_back( next_offset );
+    next_offset += id.length() + 1;
+  }
+
+  vector<boost::uint64_t> head( HEADER_SIZE , 0 );
+  memcpy( &head[0] , MAGIC , 8 );
+  head[NUM_SLOTS] = num_slots;
+  head[NUM_ENTRIES] = entries.size();
+  head[NUM_IDS] = ids.size();
+  head[IDS_OFFSET] = ( HEADER_SIZE + slots.size() ) * sizeof( boost::uint64_t );
+  head[STRINGS_OFFSET] = head[IDS_OFFSET] + id_offsets.size() * sizeof( boost::uint64_t );
+
+  ofstream ofs( filename.c_str() , ios::binary );
+  if( !ofs || !ofs.good() ) {
+    throw DACLIB::FileWriteOpenError( filename.c_str() );
+  }
+  ofs.write( reinterpret_cast<const char *>( &head[0] ) , streamsize( head.size() * sizeof( boost::uint64_t ) ) );
+  ofs.write( reinterpret_cast<const char *>( &slots[0] ) , streamsize( slots.size() * sizeof( boost::uint64_t ) ) );
+  if( !id_offsets.empty() ) {
+    ofs.write( reinterpret_cast<const char *>( &id_offsets[0] ) , streamsize( id_offsets.size() * sizeof( boost::uint64_t ) ) );
+  }
+  BOOST_FOREACH( const string &id , ids ) {
+    ofs.write( id.c_str() , streamsize( id.length() + 1 ) );
+  }
+  // a full disk shows up here, and a truncated index is worse than none
+  ofs.close();
+  if( !ofs ) {
+    throw DACLIB::FileWriteOpenError( filename.c_str() );
+  }
+
+}
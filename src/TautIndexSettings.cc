@@ -0,0 +1,106 @@
+//
+// file TautIndexSettings.cc
+// agent
+// 18th October 2026
+//
+
+#include "TautIndexSettings.H"
+
+#include <iostream>
+
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+using namespace std;
+namespace po = boost::program_options;
+
+// ********************************************************************************
+TautIndexSettings::TautIndexSettings( int argc , char **argv ) :
+  query_( false ) , are_tautomers_( false ) , orig_enumeration_( false ) , max_tauts_( 256 ) ,
+  native_engine_( false ) {
+
+  po::options_description desc( "Allowed Options" );
+  build_program_options( desc );
+
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc , argv , desc ) , vm );
+  po::notify( vm );
+
+  if( vm.count( "help" ) ) {
+    cout << desc << endl;
+    exit( 1 );
+  }
+
+  ostringstream oss;
+  oss << desc;
+  usage_text_ = oss.str();
+
+}
+
+// ********************************************************************************
+void TautIndexSettings::print_usage( std::ostream &os ) const {
+
+  os << usage_text_ << endl;
+
+}
+
+// ********************************************************************************
+void TautIndexSettings::print_error( std::ostream &os ) const {
+
+  os << error_msg_ << endl;
+
+}
+
+// ********************************************************************************
+bool TautIndexSettings::operator!() const {
+
+  if( in_mol_file_.empty() ) {
+    error_msg_ = "You must specify an input molecule file.";
+    return true;
+  }
+  if( query_ && are_tautomers_ ) {
+    error_msg_ = "You can't have both --query and --are-tautomers.";
+    return true;
+  }
+  if( index_file_.empty() && !are_tautomers_ ) {
+    error_msg_ = "You must specify an index file.";
+    return true;
+  }
+
+  return false;
+
+}
+
+// ********************************************************************************
+void TautIndexSettings::build_program_options( po::options_description &desc ) {
+
+  desc.add_options()
+      ( "help" , "Produce this help text." )
+      ( "input-molecule-file,I" , po::value<string>( &in_mol_file_ ) ,
+        "Input molecule filename, the registered compounds, or with --query the molecules to look up." )
+      ( "index-file" , po::value<string>( &index_file_ ) ,
+        "The index file, written unless --query is given." )
+      ( "query" , po::value<bool>( &query_ )->zero_tokens() ,
+        "Look the input molecules up in the index, rather than building it." )
+      ( "are-tautomers" , po::value<bool>( &are_tautomers_ )->zero_tokens() ,
+        "Take the input molecules in pairs and say whether each pair are tautomers of each other, without an index." )
+      ( "output-file,O" , po::value<string>( &out_file_ ) ,
+        "File for the results of the lookups. Defaults to standard output." )
+      ( "standardise-smirks-file,S" , po::value<string>( &stand_smirks_file_ ) ,
+        "File of SMIRKS transformations for standardisations." )
+      ( "standardize-smirks-file" , po::value<string>( &stand_smirks_file_ ) ,
+        "File of SMIRKS transformations for standardisations." )
+      ( "enumerate-smirks-file,E" , po::value<string>( &enum_smirks_file_ ) ,
+        "File of SMIRKS transformations for enumerations." )
+      ( "vector-bindings-file,V" , po::value<string>( &vb_file_ ) ,
+        "Name of file of vector bindings." )
+      ( "original-enumeration" , po::value<bool>( &orig_enumeration_ )->zero_tokens() ,
+        "Use the limited enumeration, akin to the original Leatherface, rather than the extended one. It must be the same for building and querying." )
+      ( "max-tautomers" , po::value<unsigned int>( &max_tauts_ ) ,
+        "Maximum number of tautomers per molecule." )
+      ( "native-engine" , po::value<bool>( &native_engine_ )->zero_tokens() ,
+        "Apply the simpler enumeration SMIRKS with the built-in matcher rather than OELibraryGen." );
+
+}
@@ -0,0 +1,112 @@
+//
+// file TautProfileSettings.cc
+// agent
+// 18th October 2026
+//
+
+#include "TautProfileSettings.H"
+
+#include <iostream>
+
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+using namespace std;
+namespace po = boost::program_options;
+
+// ********************************************************************************
+TautProfileSettings::TautProfileSettings( int argc , char **argv ) :
+  orig_enumeration_( false ) , extended_enumeration_( false ) ,
+  max_tauts_( 256 ) , native_engine_( false ) {
+
+  po::options_description desc( "Allowed Options" );
+  build_program_options( desc );
+
+  po::variables_map vm;
+  po::store( po::parse_command_line( argc , argv , desc ) , vm );
+  po::notify( vm );
+
+  if( vm.count( "help" ) ) {
+    cout << desc << endl;
+    exit( 1 );
+  }
+
+  ostringstream oss;
+  oss << desc;
+  usage_text_ = oss.str();
+
+}
+
+// ********************************************************************************
+void TautProfileSettings::print_usage( std::ostream &os ) const {
+
+  os << usage_text_ << endl;
+
+}
+
+// ********************************************************************************
+void TautProfileSettings::print_error( std::ostream &os ) const {
+
+  os << error_msg_ << endl;
+
+}
+
+// ********************************************************************************
+bool TautProfileSettings::operator!() const {
+
+  if( orig_enumeration_ && extended_enumeration_ ) {
+    error_msg_ = "You can't have both original and extended enumerations.";
+    return true;
+  }
+  if( !orig_enumeration_ && !extended_enumeration_ && enum_smirks_file_.empty() ) {
+    error_msg_ = "You must specify an enumeration SMIRKS file or original or extended enumeration.";
+    return true;
+  }
+  if( in_mol_file_.empty() ) {
+    error_msg_ = "You must specify an input molecule file.";
+    return true;
+  }
+  if( out_stand_smirks_file_.empty() && out_enum_smirks_file_.empty() ) {
+    error_msg_ = "You must specify at least one output SMIRKS file.";
+    return true;
+  }
+
+  return false;
+
+}
+
+// ********************************************************************************
+void TautProfileSettings::build_program_options( po::options_description &desc ) {
+
+  desc.add_options()
+      ( "help" , "Produce this help text." )
+      ( "input-molecule-file,I" , po::value<string>( &in_mol_file_ ) ,
+        "Input molecule filename, the corpus to profile the SMIRKS with." )
+      ( "standardise-smirks-file,S" , po::value<string>( &stand_smirks_file_ ) ,
+        "File of SMIRKS transformations for standardisations." )
+      ( "standardize-smirks-file" , po::value<string>( &stand_smirks_file_ ) ,
+        "File of SMIRKS transformations for standardisations." )
+      ( "enumerate-smirks-file,E" , po::value<string>( &enum_smirks_file_ ) ,
+        "File of SMIRKS transformations for enumerations." )
+      ( "vector-bindings-file,V" , po::value<string>( &vb_file_ ) ,
+        "Name of file of vector bindings." )
+      ( "original-enumeration" , po::value<bool>( &orig_enumeration_ )->zero_tokens() ,
+        "Profile the default SMIRKS for the limited enumeration, akin to the original Leatherface." )
+      ( "extended-enumeration" , po::value<bool>( &extended_enumeration_ )->zero_tokens() ,
+        "Profile the default SMIRKS for the extended enumeration." )
+      ( "max-tautomers" , po::value<unsigned int>( &max_tauts_ ) ,
+        "Maximum number of tautomers per molecule." )
+      ( "output-standardise-smirks-file" , po::value<string>( &out_stand_smirks_file_ ) ,
+        "File for the pruned standardisation SMIRKS." )
+      ( "output-enumerate-smirks-file" , po::value<string>( &out_enum_smirks_file_ ) ,
+        "File for the pruned and reordered enumeration SMIRKS." )
+      ( "output-vector-bindings-file" , po::value<string>( &out_vb_file_ ) ,
+        "File for the vector bindings the output SMIRKS need, for when the built-in ones were used." )
+      ( "report-file" , po::value<string>( &report_file_ ) ,
+        "File for the report on the SMIRKS. Defaults to standard output." )
+      ( "native-engine" , po::value<bool>( &native_engine_ )->zero_tokens() ,
+        "Experimental, not yet checked against OELibraryGen by test_dir/compare_engines.sh. Apply the simpler enumeration SMIRKS with the built-in matcher rather than OELibraryGen." );
+
+}
@@ -6,6 +6,7 @@
 //
 
 #include "TautStand.H"
+#include "DACOEMolAtomIndex.H"
 
 #include <iostream>
 
@@ -28,6 +29,8 @@ typedef boost::shared_ptr<OEChem::OEMolBase> pOEMolBase;
 // in smirks_helper_fns.cc
 namespace DACLIB {
 string create_cansmi( const OEMolBase &in_mol );
+void set_cansmi_tag( OEMolBase &mol , const string &smi ); // in cansmi_tag.cc
+string tagged_cansmi( const OEMolBase &mol ); // in cansmi_tag.cc
 void read_vbs_from_file( const string &filename ,
                          vector<pair<string,string> > &vbs );
 void read_vbs_from_string( const string &vbs_string , vector<pair<string,string> > &vbs );
@@ -40,6 +43,8 @@ void expand_vector_bindings( const vector<pair<string,string> > &in_smirks ,
 void create_libgens( const vector<string> &exp_smirks ,
                      const vector<pair<string,string> > &in_smirks ,
                      vector<pOELibGen> &lib_gens );
+bool perceive_tautomer( OEMolBase &mol , const OEMolBase &parent ); // in eponymous file
+bool stereo_specified( const OEMolBase &mol ); // in perceive_tautomer.cc
 }
 
 // ****************************************************************************
@@ -49,6 +54,7 @@ TautStand::TautStand( const string &smirks_string , const string &vb_string ) {
   DACLIB::read_smirks_from_string( smirks_string , smirks_ );
 
   DACLIB::expand_vector_bindings( smirks_ , vbs_ , exp_smirks_ );
+  fire_counts_ = vector<unsigned int>( smirks_.size() , 0 );
 
 }
 
@@ -65,6 +71,7 @@ TautStand::TautStand( const string &smirks_file , const string &vb_file ,
   DACLIB::read_smirks_from_file( smirks_file_ , smirks_ );
   DACLIB::read_vbs_from_file( vb_file , vbs_ );
   DACLIB::expand_vector_bindings( smirks_ , vbs_ , exp_smirks_ );
+  fire_counts_ = vector<unsigned int>( smirks_.size() , 0 );
 
 }
 
@@ -77,12 +84,24 @@ TautStand::TautStand( const TautStand &rhs ) {
   smirks_ = rhs.smirks_;
   vbs_ = rhs.vbs_;
   exp_smirks_ = rhs.exp_smirks_;
+  fire_counts_ = vector<unsigned int>( smirks_.size() , 0 );
 
   // lib_gens_ is filled by standardise as required, so not copying it here. A deep
   // copy would have been required otherwise, I mention for future reference.
 
 }
 
+// ****************************************************************************
+// tag the atoms with their position, for DACLIB::perceive_tautomer
+void TautStand::tag_atoms( OEMolBase &mol ) const {
+
+  unsigned int i = 0;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom , ++i ) {
+    DACLIB::set_atom_index( *atom , i );
+  }
+
+}
+
 // ****************************************************************************
 OEMolBase *TautStand::standardise( OEMolBase &in_mol , bool verbose ,
                                    bool add_smirks_to_name , bool strip_salts ) {
@@ -98,6 +117,12 @@ OEMolBase *TautStand::standardise( OEMolBase &in_mol , bool verbose ,
   }
 
   pOEMolBase prod_mol( OENewMolBase( in_mol , OEMolBaseType::OEDefault ) );
+  // the counterions are dropped once, here, rather than being carried through
+  // every match and copy and stripped from each product. It also means they go
+  // when no SMIRKS fires.
+  if( strip_salts ) {
+    OETheFunctionFormerlyKnownAsStripSalts( *prod_mol );
+  }
   // keep track of all intermediate SMILES strings in case we go round in an infinite loop.
   // most likely that will be a tautomer flipping backwards and forwards, but in principle it
   // could be a loop of more tautomers.  The SMIRKS aren't supposed to create such loops
@@ -105,7 +130,13 @@ OEMolBase *TautStand::standardise( OEMolBase &in_mol , bool verbose ,
   // If this happens, return the last one found. It's in a standard form, after all, so should
   // be fine for further use.
   set<string> all_smis;
-  all_smis.insert( DACLIB::create_cansmi( in_mol ) );
+  // the tag's no good if salts have been stripped
+  string prod_smi = strip_salts ? DACLIB::create_cansmi( *prod_mol ) : DACLIB::tagged_cansmi( *prod_mol );
+  all_smis.insert( prod_smi );
+  // whether prod_mol still needs OEPerceiveChiral
+  bool chiral_stale = false;
+  // so each product's perception can be taken from the molecule it was made from
+  tag_atoms( *prod_mol );
 
   while( true ) {
     size_t smis_size = all_smis.size();
@@ -120,21 +151,29 @@ OEMolBase *TautStand::standardise( OEMolBase &in_mol , bool verbose ,
         // the molecule, so don't do anything if it returns 0
         if( libgen->SetStartingMaterial( *prod_mol , 0 , false ) ) {
           OEIter<OEMolBase> prod = libgen->GetProducts();
+          ++fire_counts_[smirks_num];
+          pOEMolBase parent_mol( prod_mol );
           prod_mol.reset( OENewMolBase( *prod , OEMolBaseType::OEDefault ) );
-          if( strip_salts ) {
-            OETheFunctionFormerlyKnownAsStripSalts( *prod_mol );
+          if( !DACLIB::perceive_tautomer( *prod_mol , *parent_mol ) ) {
+            OEFindRingAtomsAndBonds( *prod_mol );
+            OEAssignAromaticFlags( *prod_mol );
           }
-          OEFindRingAtomsAndBonds( *prod_mol );
-          OEAssignAromaticFlags( *prod_mol );
-          OEPerceiveChiral( *prod_mol );
+          // chirality only shows in the SMILES if there's some stereochemistry,
+          // so otherwise it's left until the final answer.
+          chiral_stale = !DACLIB::stereo_specified( *prod_mol );
+          if( !chiral_stale ) {
+            OEPerceiveChiral( *prod_mol );
+          }
+          tag_atoms( *prod_mol );
           string this_smi = DACLIB::create_cansmi( *prod_mol );
+          prod_smi = this_smi;
           if( !all_smis.insert( this_smi ).second ) {
             cerr << "Problem with TautStand : " << in_mol.GetTitle()
                  << " creates an infinite loop of tautomers." << endl;
             break;
           }
           if( verbose ) {
-            cout << "New product in tautomer standardiser : " << DACLIB::create_cansmi( *prod_mol ) << endl
+            cout << "New product in tautomer standardiser : " << this_smi << endl
                  << "Made from " << smirks_[smirks_num].first << " : " << smirks_[smirks_num].second << endl;
           }
           if( add_smirks_to_name ) {
@@ -152,10 +191,15 @@ OEMolBase *TautStand::standardise( OEMolBase &in_mol , bool verbose ,
       break; // didn't add anything new
     }
   }
+  if( chiral_stale ) {
+    OEPerceiveChiral( *prod_mol );
+  }
 #ifdef NOTYET
   cout << "Final answer : " << DACLIB::create_cansmi( *prod_mol ) << endl;
 #endif
 
-  return OENewMolBase( *prod_mol , OEMolBaseType::OEDefault );
+  OEMolBase *ret_mol = OENewMolBase( *prod_mol , OEMolBaseType::OEDefault );
+  DACLIB::set_cansmi_tag( *ret_mol , prod_smi );
+  return ret_mol;
 
 }
@@ -26,6 +26,10 @@
 using namespace std;
 using namespace OEChem;
 
+namespace DACLIB {
+void set_cansmi_tag( OEMolBase &mol , const string &smi ); // in cansmi_tag.cc
+}
+
 // ****************************************************************************
 void prepare_molecule( OEMolBase &mol ) {
 
@@ -40,6 +44,14 @@ void prepare_molecule( OEMolBase &mol ) {
   mol.Clear();
   OEParseSmiles( mol , can_smi );
   mol.SetTitle( mol_name );
+  // this is what create_cansmi would give, unless there are R groups, which
+  // it writes differently, so it needn't be made again.
+  for( OESystem::OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( !atom->GetAtomicNum() ) {
+      return;
+    }
+  }
+  DACLIB::set_cansmi_tag( mol , can_smi );
 
 }
 
@@ -150,6 +162,32 @@ OEMolBase *canonical_tautomer( OEMolBase &in_mol ) {
 
 }
 
+// *********************************************************************************
+// whether the two molecules are tautomers of each other by the extended rules.
+// If there are too many tautomers to tell, they're taken not to be.
+bool are_tautomers( OEMolBase &mol_a , OEMolBase &mol_b ) {
+
+  static TautEnum *taut_enum = 0;
+  if( !taut_enum ) {
+    taut_enum = new TautEnum( DACLIB::ENUM_SMIRKS_EXTENDED , DACLIB::VBS );
+  }
+
+  OEMolBase *std_mol_a = standardise_tautomer( mol_a );
+  OEMolBase *std_mol_b = standardise_tautomer( mol_b );
+  bool ret_val = false;
+  try {
+    ret_val = taut_enum->are_tautomers( *std_mol_a , *std_mol_b );
+  } catch( TooManyOutMols &e ) {
+    cerr << "Maximum number of tautomers generated for " << mol_a.GetTitle()
+         << " and " << mol_b.GetTitle() << " without finding a common one." << endl;
+  }
+  delete std_mol_a;
+  delete std_mol_b;
+
+  return ret_val;
+
+}
+
 // *********************************************************************************
 // generate set of SMILES strings for tautomers of in_smi. First entry in
 // return vector will be a canonical SMILES for the input string, followed
@@ -0,0 +1,90 @@
+//
+// file cansmi_tag.cc
+// agent
+// 18th October 2026
+//
+// The canonical SMILES of a molecule, as made by create_cansmi, kept on the
+// molecule as generic data once it's been made, so that it needn't be made
+// again for sorting, deduplication and writing. Generic data goes with the
+// molecule when it's copied, and there's no knowing what's been done to a
+// copy since, so the tag is stored with a signature of the atoms and bonds
+// it was made for, and only used if the molecule still matches it.
+// Otherwise the SMILES is made afresh. The signature covers the elements,
+// isotopes, charges, hydrogen counts, aromaticity and bond orders, which is
+// everything that standardisation, tautomer enumeration and protonation
+// change, but not stereochemistry, which nothing here touches after the tag
+// is set.
+
+#include <oechem.h>
+
+#include <string>
+
+using namespace std;
+using namespace OEChem;
+
+namespace DACLIB {
+
+string create_cansmi( const OEMolBase &in_mol ); // in create_cansmi.cc
+
+static const unsigned int CANSMI_TAG = OESystem::OEGetTag( "DACLIB_CANSMI_TAG" );
+static const unsigned int CANSMI_SIG_TAG = OESystem::OEGetTag( "DACLIB_CANSMI_SIG_TAG" );
+
+// ****************************************************************************
+static void add_to_signature( unsigned int val , string &sig ) {
+
+  sig.append( reinterpret_cast<const char *>( &val ) , sizeof( val ) );
+
+}
+
+// ****************************************************************************
+static string cansmi_signature( const OEMolBase &mol ) {
+
+  string sig;
+  sig.reserve( 4 * sizeof( unsigned int ) * ( mol.NumAtoms() + mol.NumBonds() ) );
+  for( OESystem::OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    add_to_signature( atom->GetIdx() , sig );
+    add_to_signature( ( atom->GetAtomicNum() << 16 ) | atom->GetIsotope() , sig );
+    add_to_signature( static_cast<unsigned int>( atom->GetFormalCharge() ) , sig );
+    add_to_signature( ( atom->GetImplicitHCount() << 1 ) | ( atom->IsAromatic() ? 1 : 0 ) , sig );
+  }
+  for( OESystem::OEIter<OEBondBase> bond = mol.GetBonds() ; bond ; ++bond ) {
+    add_to_signature( bond->GetBgnIdx() , sig );
+    add_to_signature( bond->GetEndIdx() , sig );
+    add_to_signature( ( bond->GetOrder() << 1 ) | ( bond->IsAromatic() ? 1 : 0 ) , sig );
+  }
+  return sig;
+
+}
+
+// ****************************************************************************
+void set_cansmi_tag( OEMolBase &mol , const string &smi ) {
+
+  mol.DeleteData( CANSMI_TAG );
+  mol.DeleteData( CANSMI_SIG_TAG );
+  mol.SetData<string>( CANSMI_TAG , smi );
+  mol.SetData<string>( CANSMI_SIG_TAG , cansmi_signature( mol ) );
+
+}
+
+// ****************************************************************************
+void clear_cansmi_tag( OEMolBase &mol ) {
+
+  mol.DeleteData( CANSMI_TAG );
+  mol.DeleteData( CANSMI_SIG_TAG );
+
+}
+
+// ****************************************************************************
+// the tag if there is one and the molecule hasn't changed since it was set,
+// otherwise create_cansmi.
+string tagged_cansmi( const OEMolBase &mol ) {
+
+  if( mol.HasData( CANSMI_TAG ) && mol.HasData( CANSMI_SIG_TAG ) &&
+      mol.GetData<string>( CANSMI_SIG_TAG ) == cansmi_signature( mol ) ) {
+    return mol.GetData<string>( CANSMI_TAG );
+  }
+  return create_cansmi( mol );
+
+}
+
+} // EO namespace DACLIB
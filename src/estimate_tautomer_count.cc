@@ -0,0 +1,166 @@
+//
+// file estimate_tautomer_count.cc
+// agent
+// 18th October 2026
+//
+// A quick estimate of the number of tautomers a molecule has, for deciding
+// whether it's worth enumerating them, made without applying any SMIRKS.
+// The sites a hydrogen can move between are the nitrogens, oxygens and
+// sulphurs in or next to a conjugated system and, optionally, carbons with
+// a hydrogen next to a C=X, as for keto-enol tautomerism. The conjugated
+// atoms and the sites split the molecule into independent regions. In each,
+// the hydrogens on its sites can be anywhere amongst them, so the estimate
+// for the region is the number of ways of choosing that many sites from
+// them, and for the molecule the product over the regions. It ignores
+// valence, so it's usually an over-estimate, sometimes a large one, and it
+// knows nothing of the SMIRKS, so can be an under-estimate too.
+
+#include <vector>
+
+#include <oechem.h>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+
+// ****************************************************************************
+static bool conjugated_atom( const OEAtomBase &atom ) {
+
+  if( atom.IsAromatic() ) {
+    return true;
+  }
+  for( OEIter<OEBondBase> bond = atom.GetBonds() ; bond ; ++bond ) {
+    if( bond->GetOrder() > 1 ) {
+      return true;
+    }
+  }
+  return false;
+
+}
+
+// ****************************************************************************
+static bool hetero_site( const OEAtomBase &atom , const vector<char> &conj ) {
+
+  unsigned int an = atom.GetAtomicNum();
+  if( OEElemNo::N != an && OEElemNo::O != an && OEElemNo::S != an ) {
+    return false;
+  }
+  if( conj[atom.GetIdx()] ) {
+    return true;
+  }
+  for( OEIter<OEAtomBase> nbr = atom.GetAtoms() ; nbr ; ++nbr ) {
+    if( conj[nbr->GetIdx()] ) {
+      return true;
+    }
+  }
+  return false;
+
+}
+
+// ****************************************************************************
+// a saturated carbon with a hydrogen, next to a carbon double bonded to a
+// heteroatom.
+static bool carbon_site( const OEAtomBase &atom , const vector<char> &conj ) {
+
+  if( OEElemNo::C != atom.GetAtomicNum() || conj[atom.GetIdx()] || !atom.GetTotalHCount() ) {
+    return false;
+  }
+  for( OEIter<OEAtomBase> nbr = atom.GetAtoms() ; nbr ; ++nbr ) {
+    if( OEElemNo::C != nbr->GetAtomicNum() ) {
+      continue;
+    }
+    for( OEIter<OEBondBase> bond = nbr->GetBonds() ; bond ; ++bond ) {
+      OEAtomBase *other = bond->GetNbr( nbr );
+      if( 2 == bond->GetOrder() && OEElemNo::C != other->GetAtomicNum() &&
+          OEElemNo::H != other->GetAtomicNum() ) {
+        return true;
+      }
+    }
+  }
+  return false;
+
+}
+
+// ****************************************************************************
+static unsigned int find_root( vector<unsigned int> &roots , unsigned int i ) {
+
+  while( roots[i] != i ) {
+    roots[i] = roots[roots[i]];
+    i = roots[i];
+  }
+  return i;
+
+}
+
+// ****************************************************************************
+// The molecule should have had its aromaticity perceived. num_sites and
+// num_regions are the numbers of sites, and of regions with sites in.
+double estimate_tautomer_count( const OEMolBase &mol , bool carbon_sites ,
+                                unsigned int &num_sites , unsigned int &num_regions ) {
+
+  num_sites = num_regions = 0;
+
+  vector<char> conj( mol.GetMaxAtomIdx() , 0 );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H != atom->GetAtomicNum() ) {
+      conj[atom->GetIdx()] = conjugated_atom( atom );
+    }
+  }
+
+  vector<char> site( mol.GetMaxAtomIdx() , 0 );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( hetero_site( atom , conj ) || ( carbon_sites && carbon_site( atom , conj ) ) ) {
+      site[atom->GetIdx()] = 1;
+      ++num_sites;
+    }
+  }
+
+  // the regions are the connected sets of conjugated atoms and sites
+  vector<unsigned int> roots( mol.GetMaxAtomIdx() , 0 );
+  for( unsigned int i = 0 , is = static_cast<unsigned int>( roots.size() ) ; i < is ; ++i ) {
+    roots[i] = i;
+  }
+  for( OEIter<OEBondBase> bond = mol.GetBonds() ; bond ; ++bond ) {
+    unsigned int b = bond->GetBgn()->GetIdx() , e = bond->GetEnd()->GetIdx();
+    if( ( conj[b] || site[b] ) && ( conj[e] || site[e] ) ) {
+      roots[find_root( roots , b )] = find_root( roots , e );
+    }
+  }
+
+  vector<unsigned int> region_sites( roots.size() , 0 ) , region_hs( roots.size() , 0 );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( !site[atom->GetIdx()] ) {
+      continue;
+    }
+    unsigned int root = find_root( roots , atom->GetIdx() );
+    ++region_sites[root];
+    if( atom->GetTotalHCount() ) {
+      ++region_hs[root];
+    }
+  }
+
+  double ret_val = 1.0;
+  for( size_t i = 0 , is = region_sites.size() ; i < is ; ++i ) {
+    if( !region_sites[i] ) {
+      continue;
+    }
+    ++num_regions;
+    // sites choose hydrogens
+    unsigned int n = region_sites[i] , k = region_hs[i];
+    if( k > n - k ) {
+      k = n - k;
+    }
+    double ways = 1.0;
+    for( unsigned int j = 1 ; j <= k ; ++j ) {
+      ways = ways * double( n - k + j ) / double( j );
+    }
+    ret_val *= ways;
+  }
+
+  return ret_val;
+
+}
+
+} // EO namespace DACLIB
@@ -0,0 +1,45 @@
+//
+// file hash_smiles_128.cc
+// agent
+// 18th October 2026
+//
+// A 128-bit hash of a SMILES string, as two 64-bit halves, for use as a key
+// when keeping the strings themselves would take too much room. Each half is
+// FNV-1a from a different offset, put through MurmurHash3's 64-bit finaliser
+// to spread the bits. The chance of two different strings colliding is
+// negligible for any number of molecules we're likely to see.
+
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+using namespace std;
+
+namespace DACLIB {
+
+// ****************************************************************************
+static boost::uint64_t fnv1a_fmix64( const string &str , boost::uint64_t h ) {
+
+  for( string::const_iterator c = str.begin() ; c != str.end() ; ++c ) {
+    h ^= static_cast<unsigned char>( *c );
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+
+}
+
+// ****************************************************************************
+void hash_smiles_128( const string &smiles , boost::uint64_t &hi , boost::uint64_t &lo ) {
+
+  hi = fnv1a_fmix64( smiles , 0xcbf29ce484222325ULL );
+  lo = fnv1a_fmix64( smiles , 0x84222325cbf29ce4ULL );
+
+}
+
+} // EO namespace DACLIB
@@ -0,0 +1,163 @@
+//
+// file parse_smarts_graph.cc
+// agent
+// 18th October 2026
+//
+// Crude, text-based breakdown of a SMARTS string into atoms and bonds.
+// See SmartsGraph.H.
+
+#include "SmartsGraph.H"
+
+#include <cctype>
+#include <map>
+#include <stack>
+
+using namespace std;
+
+namespace DACLIB {
+
+size_t find_closing( const string &smarts , size_t start ); // in smarts_radius.cc
+
+// *******************************************************************************
+// split the map index off the end of the contents of a bracket atom, bearing in
+// mind there might be recursive SMARTS in there.
+void split_map_index( const string &contents , SmartsAtom &atom ) {
+
+  atom.expr_ = contents;
+  atom.map_ = 0;
+
+  int depth = 0;
+  size_t colon = string::npos;
+  for( size_t i = 0 , is = contents.length() ; i < is ; ++i ) {
+    if( '(' == contents[i] ) {
+      ++depth;
+    } else if( ')' == contents[i] ) {
+      --depth;
+    } else if( ':' == contents[i] && !depth ) {
+      colon = i;
+    }
+  }
+  if( string::npos == colon || colon + 1 == contents.length() ) {
+    return;
+  }
+  unsigned int map_idx = 0;
+  for( size_t i = colon + 1 , is = contents.length() ; i < is ; ++i ) {
+    if( !isdigit( contents[i] ) ) {
+      return;
+    }
+    map_idx = 10 * map_idx + static_cast<unsigned int>( contents[i] - '0' );
+  }
+  atom.expr_ = contents.substr( 0 , colon );
+  atom.map_ = map_idx;
+
+}
+
+// *******************************************************************************
+bool parse_smarts_graph( const string &smarts , vector<SmartsAtom> &atoms ,
+                         vector<SmartsBond> &bonds ) {
+
+  atoms.clear();
+  bonds.clear();
+
+  int prev_atom = -1;
+  char bond = 0;
+  stack<int> branches;
+  map<unsigned int,pair<int,char> > ring_opens;
+
+  for( size_t i = 0 , is = smarts.length() ; i < is ; ++i ) {
+    char c = smarts[i];
+    string atom_text;
+    bool bracket = false;
+    if( '[' == c ) {
+      size_t j = find_closing( smarts , i );
+      if( string::npos == j ) {
+        return false;
+      }
+      atom_text = smarts.substr( i + 1 , j - i - 1 );
+      bracket = true;
+      i = j;
+    } else if( 'C' == c && i + 1 < is && 'l' == smarts[i+1] ) {
+      atom_text = "Cl";
+      ++i;
+    } else if( 'B' == c && i + 1 < is && 'r' == smarts[i+1] ) {
+      atom_text = "Br";
+      ++i;
+    } else if( string::npos != string( "BCNOPSFIcnopsb*Aa" ).find( c ) ) {
+      atom_text = string( 1 , c );
+    } else if( '(' == c ) {
+      branches.push( prev_atom );
+      continue;
+    } else if( ')' == c ) {
+      if( branches.empty() ) {
+        return false;
+      }
+      prev_atom = branches.top();
+      branches.pop();
+      continue;
+    } else if( string::npos != string( "-=#:~" ).find( c ) ) {
+      if( bond ) {
+        return false; // compound bond expression
+      }
+      bond = c;
+      continue;
+    } else if( isdigit( c ) || '%' == c ) {
+      unsigned int ring_num = 0;
+      if( '%' == c ) {
+        if( i + 2 >= is || !isdigit( smarts[i+1] ) || !isdigit( smarts[i+2] ) ) {
+          return false;
+        }
+        ring_num = 10 * static_cast<unsigned int>( smarts[i+1] - '0' ) + static_cast<unsigned int>( smarts[i+2] - '0' );
+        i += 2;
+      } else {
+        ring_num = static_cast<unsigned int>( c - '0' );
+      }
+      if( -1 == prev_atom ) {
+        return false;
+      }
+      map<unsigned int,pair<int,char> >::iterator p = ring_opens.find( ring_num );
+      if( p == ring_opens.end() ) {
+        ring_opens.insert( make_pair( ring_num , make_pair( prev_atom , bond ) ) );
+      } else {
+        SmartsBond sb;
+        sb.a_ = static_cast<unsigned int>( p->second.first );
+        sb.b_ = static_cast<unsigned int>( prev_atom );
+        sb.bond_ = bond ? bond : ( p->second.second ? p->second.second : ' ' );
+        sb.ring_closure_ = true;
+        bonds.push_back( sb );
+        ring_opens.erase( p );
+      }
+      bond = 0;
+      continue;
+    } else {
+      // dots, stereo bonds, bond expressions with logical operators etc.
+      return false;
+    }
+
+    SmartsAtom sa;
+    if( bracket ) {
+      split_map_index( atom_text , sa );
+    } else {
+      sa.expr_ = atom_text;
+      sa.map_ = 0;
+    }
+    atoms.push_back( sa );
+    int this_atom = static_cast<int>( atoms.size() ) - 1;
+    if( -1 != prev_atom ) {
+      SmartsBond sb;
+      sb.a_ = static_cast<unsigned int>( prev_atom );
+      sb.b_ = static_cast<unsigned int>( this_atom );
+      sb.bond_ = bond ? bond : ' ';
+      sb.ring_closure_ = false;
+      bonds.push_back( sb );
+    } else if( this_atom ) {
+      return false; // a 2nd component
+    }
+    bond = 0;
+    prev_atom = this_atom;
+  }
+
+  return ring_opens.empty() && branches.empty() && !bond && !atoms.empty();
+
+}
+
+} // EO namespace DACLIB
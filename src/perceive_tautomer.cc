@@ -0,0 +1,258 @@
+//
+// file perceive_tautomer.cc
+// agent
+// 18th October 2026
+//
+// Ring and aromaticity perception for a tautomer, using that already done
+// on the molecule it was made from. A tautomeric change only moves
+// hydrogens and alters bond orders, so the rings are the same, and the
+// aromaticity can only change in ring systems containing an atom whose
+// hydrogen count, charge or bonds were altered. Those are perceived again
+// in a small molecule made of just the ring system and the atoms attached
+// to it, unless they're most of the molecule anyway. The heavy atoms of the
+// parent must be tagged with DACLIB::ATOM_INDEX_TAG before the tautomer is
+// made, and the tautomer's keep the tags, as they do if it is a copy.
+
+#include "DACOEMolAtomIndex.H"
+
+#include <deque>
+#include <vector>
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+
+// ****************************************************************************
+// the parent atom for each atom in mol, by GetIdx(), null for hydrogens.
+// Returns false if any heavy atom doesn't have one of the right element and
+// with the same heavy atom neighbours.
+static bool map_to_parent( OEMolBase &mol , const OEMolBase &parent ,
+                           vector<OEAtomBase *> &parent_atoms ) {
+
+  vector<OEAtomBase *> by_tag;
+  for( OEIter<OEAtomBase> atom = parent.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H != atom->GetAtomicNum() && atom->HasData( ATOM_INDEX_TAG ) ) {
+      unsigned int tag = atom->GetData<unsigned int>( ATOM_INDEX_TAG );
+      if( tag >= by_tag.size() ) {
+        by_tag.resize( tag + 1 , static_cast<OEAtomBase *>( 0 ) );
+      }
+      by_tag[tag] = atom;
+    }
+  }
+
+  parent_atoms = vector<OEAtomBase *>( mol.GetMaxAtomIdx() , static_cast<OEAtomBase *>( 0 ) );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H == atom->GetAtomicNum() ) {
+      continue;
+    }
+    if( !atom->HasData( ATOM_INDEX_TAG ) ) {
+      return false;
+    }
+    unsigned int tag = atom->GetData<unsigned int>( ATOM_INDEX_TAG );
+    if( tag >= by_tag.size() || !by_tag[tag] ||
+        by_tag[tag]->GetAtomicNum() != atom->GetAtomicNum() ||
+        by_tag[tag]->GetHvyDegree() != atom->GetHvyDegree() ) {
+      return false;
+    }
+    parent_atoms[atom->GetIdx()] = by_tag[tag];
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+// Copy the ring flags and aromaticity from the parent, and mark the heavy
+// atoms that differ from their parent. Returns false if a bond between heavy
+// atoms isn't in the parent.
+static bool copy_from_parent( OEMolBase &mol , const OEMolBase &parent ,
+                              const vector<OEAtomBase *> &parent_atoms ,
+                              vector<char> &changed ) {
+
+  changed = vector<char>( mol.GetMaxAtomIdx() , 0 );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    OEAtomBase *pa = parent_atoms[atom->GetIdx()];
+    if( !pa ) {
+      atom->SetInRing( false );
+      atom->SetAromatic( false );
+      continue;
+    }
+    atom->SetInRing( pa->IsInRing() );
+    atom->SetAromatic( pa->IsAromatic() );
+    if( atom->GetTotalHCount() != pa->GetTotalHCount() ||
+        atom->GetFormalCharge() != pa->GetFormalCharge() ) {
+      changed[atom->GetIdx()] = 1;
+    }
+  }
+
+  for( OEIter<OEBondBase> bond = mol.GetBonds() ; bond ; ++bond ) {
+    OEAtomBase *pb = parent_atoms[bond->GetBgn()->GetIdx()];
+    OEAtomBase *pe = parent_atoms[bond->GetEnd()->GetIdx()];
+    if( !pb || !pe ) {
+      bond->SetInRing( false );
+      bond->SetAromatic( false );
+      continue;
+    }
+    OEBondBase *pbond = parent.GetBond( pb , pe );
+    if( !pbond ) {
+      return false;
+    }
+    bond->SetInRing( pbond->IsInRing() );
+    bond->SetAromatic( pbond->IsAromatic() );
+    if( bond->GetOrder() != pbond->GetOrder() ) {
+      changed[bond->GetBgn()->GetIdx()] = 1;
+      changed[bond->GetEnd()->GetIdx()] = 1;
+    }
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+// The atoms in the ring systems that contain changed atoms, by GetIdx().
+static void affected_ring_systems( OEMolBase &mol , const vector<char> &changed ,
+                                   vector<char> &in_region ,
+                                   vector<OEAtomBase *> &region ) {
+
+  in_region = vector<char>( mol.GetMaxAtomIdx() , 0 );
+  deque<OEAtomBase *> to_do;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( changed[atom->GetIdx()] && atom->IsInRing() && !in_region[atom->GetIdx()] ) {
+      in_region[atom->GetIdx()] = 1;
+      region.push_back( atom );
+      to_do.push_back( atom );
+    }
+  }
+  while( !to_do.empty() ) {
+    OEAtomBase *atom = to_do.front();
+    to_do.pop_front();
+    for( OEIter<OEBondBase> bond = atom->GetBonds() ; bond ; ++bond ) {
+      OEAtomBase *nbr = bond->GetNbr( atom );
+      if( bond->IsInRing() && !in_region[nbr->GetIdx()] ) {
+        in_region[nbr->GetIdx()] = 1;
+        region.push_back( nbr );
+        to_do.push_back( nbr );
+      }
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Aromaticity for the region, from a molecule made of it and the atoms bonded
+// to it, which is all the aromaticity model looks at.
+static void reperceive_region( OEMolBase &mol , const vector<char> &in_region ,
+                               const vector<OEAtomBase *> &region ) {
+
+  OEGraphMol sub;
+  vector<OEAtomBase *> sub_atom( mol.GetMaxAtomIdx() , static_cast<OEAtomBase *>( 0 ) );
+  vector<pair<OEBondBase *,OEBondBase *> > sub_bonds; // mol bond, sub bond
+
+  BOOST_FOREACH( OEAtomBase *atom , region ) {
+    OEAtomBase *sa = sub.NewAtom( atom->GetAtomicNum() );
+    sa->SetFormalCharge( atom->GetFormalCharge() );
+    sa->SetImplicitHCount( atom->GetImplicitHCount() );
+    sub_atom[atom->GetIdx()] = sa;
+  }
+  BOOST_FOREACH( OEAtomBase *atom , region ) {
+    for( OEIter<OEBondBase> bond = atom->GetBonds() ; bond ; ++bond ) {
+      OEAtomBase *nbr = bond->GetNbr( atom );
+      if( in_region[nbr->GetIdx()] ) {
+        // each ring bond once
+        if( nbr->GetIdx() < atom->GetIdx() ) {
+          sub_bonds.push_back( make_pair( static_cast<OEBondBase *>( bond ) ,
+                                          sub.NewBond( sub_atom[atom->GetIdx()] ,
+                                                       sub_atom[nbr->GetIdx()] ,
+                                                       bond->GetOrder() ) ) );
+        }
+        continue;
+      }
+      // substituent atoms only matter for their element and the bond to the
+      // ring, and are never in this ring system.
+      OEAtomBase *sa = sub.NewAtom( nbr->GetAtomicNum() );
+      sa->SetFormalCharge( nbr->GetFormalCharge() );
+      sa->SetImplicitHCount( nbr->GetImplicitHCount() );
+      sub.NewBond( sub_atom[atom->GetIdx()] , sa , bond->GetOrder() );
+    }
+  }
+
+  OEFindRingAtomsAndBonds( sub );
+  OEAssignAromaticFlags( sub );
+
+  BOOST_FOREACH( OEAtomBase *atom , region ) {
+    atom->SetAromatic( sub_atom[atom->GetIdx()]->IsAromatic() );
+  }
+  for( size_t i = 0 , is = sub_bonds.size() ; i < is ; ++i ) {
+    sub_bonds[i].first->SetAromatic( sub_bonds[i].second->IsAromatic() );
+  }
+
+}
+
+// ****************************************************************************
+// Does ring and aromaticity perception for mol, a tautomer of parent, which
+// must have had both done. Returns false, having done nothing, if mol can't
+// be related back to parent, in which case OEFindRingAtomsAndBonds and
+// OEAssignAromaticFlags should be used instead.
+bool perceive_tautomer( OEMolBase &mol , const OEMolBase &parent ) {
+
+  vector<OEAtomBase *> parent_atoms;
+  if( !map_to_parent( mol , parent , parent_atoms ) ) {
+    return false;
+  }
+  vector<char> changed;
+  if( !copy_from_parent( mol , parent , parent_atoms , changed ) ) {
+    return false;
+  }
+  mol.SetPerceived( OEPerceived::Rings , true );
+
+  vector<char> in_region;
+  vector<OEAtomBase *> region;
+  affected_ring_systems( mol , changed , in_region , region );
+  if( region.empty() ) {
+    return true;
+  }
+
+  unsigned int num_hvy = 0;
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H != atom->GetAtomicNum() ) {
+      ++num_hvy;
+    }
+  }
+  if( 2 * region.size() > num_hvy ) {
+    OEAssignAromaticFlags( mol );
+  } else {
+    reperceive_region( mol , in_region , region );
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+// true if any atom or bond in mol has its stereochemistry specified, which
+// is when chirality perception makes a difference to a SMILES string.
+bool stereo_specified( const OEMolBase &mol ) {
+
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( atom->HasStereoSpecified() ) {
+      return true;
+    }
+  }
+  for( OEIter<OEBondBase> bond = mol.GetBonds() ; bond ; ++bond ) {
+    if( bond->HasStereoSpecified() ) {
+      return true;
+    }
+  }
+
+  return false;
+
+}
+
+} // EO namespace DACLIB
@@ -5,16 +5,14 @@
 // 15th February 2013
 //
 // This function takes a molecule and builds a list of those atoms that
-// are free radicals, taken from a selected list of elements.
+// are free radicals, taken from a selected list of elements. radical_atom()
+// does the test for a single atom.
 
-#include <map>
 #include <vector>
 
 #include <oechem.h>
 #include <oedepict.h>
 
-#include <boost/tuple/tuple.hpp>
-
 using namespace OEChem;
 using namespace OEDepict;
 using namespace OESystem;
@@ -22,42 +20,49 @@ using namespace OESystem;
 namespace DACLIB {
 
 // *****************************************************************************
-void radical_atoms( OEMolBase &mol ,
-                    std::vector<OEAtomBase *> &rad_atoms ) {
+// For the elements that are checked, the numbers of electrons that can make
+// up an octet with the atom's bonds, -1 for no more. Indexed by atomic number,
+// up to sulfur.
+static const int ELECTRONS[17][3] = {
+  { -1 , -1 , -1 } , { -1 , -1 , -1 } , { -1 , -1 , -1 } , { -1 , -1 , -1 } ,
+  { -1 , -1 , -1 } , { -1 , -1 , -1 } ,
+  { 4 , -1 , -1 } , // C
+  { 5 , -1 , -1 } , // N
+  { 6 , -1 , -1 } , // O
+  { -1 , -1 , -1 } , { -1 , -1 , -1 } , { -1 , -1 , -1 } , { -1 , -1 , -1 } ,
+  { -1 , -1 , -1 } ,
+  { 4 , -1 , -1 } , // Si
+  { 5 , 3 , -1 } , // P
+  { 6 , 4 , 2 } // S
+};
+
+// *****************************************************************************
+bool radical_atom( const OEAtomBase &atom ) {
+
+  unsigned int atomic_num = atom.GetAtomicNum();
+  if( atomic_num >= sizeof( ELECTRONS ) / sizeof( ELECTRONS[0] ) ||
+      -1 == ELECTRONS[atomic_num][0] ) {
+    return false;
+  }
 
-  static std::map<unsigned int,boost::tuple<int,int,int> > ELECTRONS;
-  if( ELECTRONS.empty() ) {
-    ELECTRONS[OEElemNo::C] = boost::tuple<int,int,int>( 4 , -1 , -1 );
-    ELECTRONS[OEElemNo::N] = boost::tuple<int,int,int>( 5 , -1 , -1 );
-    ELECTRONS[OEElemNo::O] = boost::tuple<int,int,int>( 6 , -1 , -1 );
-    ELECTRONS[OEElemNo::Si] = boost::tuple<int,int,int>( 4 , -1 , -1 );
-    ELECTRONS[OEElemNo::P] = boost::tuple<int,int,int>( 5 , 3 , -1 );
-    ELECTRONS[OEElemNo::S] = boost::tuple<int,int,int>( 6 , 4 , 2 );
+  int val = static_cast<int>( atom.GetValence() ) - atom.GetFormalCharge();
+  for( int i = 0 ; i < 3 && -1 != ELECTRONS[atomic_num][i] ; ++i ) {
+    if( 8 == ELECTRONS[atomic_num][i] + val ) {
+      return false;
+    }
   }
 
+  return true;
+
+}
+
+// *****************************************************************************
+void radical_atoms( OEMolBase &mol ,
+                    std::vector<OEAtomBase *> &rad_atoms ) {
+
   for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
-    std::map<unsigned int,boost::tuple<int,int,int> >::iterator p = ELECTRONS.find( atom->GetAtomicNum() );
-    if( p != ELECTRONS.end() ) {
-      bool rad = true;
-      int n = p->second.get<0>() + atom->GetValence() - atom->GetFormalCharge();
-      if( !(n - 8) ) {
-        rad = false;
-      }
-      if( -1 != p->second.get<1>() ) {
-        n = p->second.get<1>() + atom->GetValence() - atom->GetFormalCharge();
-        if( !(n - 8) ) {
-          rad = false;
-        }
-      }
-      if( -1 != p->second.get<2>() ) {
-        n = p->second.get<2>() + atom->GetValence() - atom->GetFormalCharge();
-        if( !(n - 8) ) {
-          rad = false;
-        }
-      }
-      if( rad ) {
-        rad_atoms.push_back( atom );
-      }
+    if( radical_atom( *atom ) ) {
+      rad_atoms.push_back( atom );
     }
   }
 
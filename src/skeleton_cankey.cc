@@ -0,0 +1,452 @@
+//
+// file skeleton_cankey.cc
+// agent
+// 18th October 2026
+//
+// A canonical key for a tautomer, quicker to make than a canonical SMILES,
+// for spotting duplicates during enumeration. All the tautomers of a molecule
+// have the same heavy atom skeleton, so its symmetry classes are worked out
+// once, by tag_skeleton_classes, and put on the atoms as generic data, which
+// copies of the molecule keep. skeleton_canonical_key starts from those and
+// refines them with the tautomer's own bond orders, hydrogen counts and
+// charges. If that doesn't tell all the atoms apart, each way of breaking the
+// ties is tried and the smallest result kept, up to a limit. Ways that are
+// the same as one already tried by a symmetry of the molecule found along the
+// way aren't tried again, so symmetrical molecules don't use up the limit.
+// The key is the whole heavy atom graph written out in the canonical order,
+// so two molecules have the same key only if they're the same molecule,
+// apart from stereochemistry, which isn't in it. Aromatic bonds are labelled
+// as aromatic, not by their order, so different Kekule structures of the same
+// aromatic system give the same key.
+// skeleton_connectivity_key is the same thing for the heavy atoms and their
+// connections alone, which all the tautomers of a molecule share.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+
+static const unsigned int SKELETON_CLASS_TAG = OEGetTag( "DACLIB_SKELETON_CLASS_TAG" );
+// the most ways of breaking ties tried before giving up, not counting those
+// skipped by symmetry.
+static const unsigned int MAX_LEAVES = 64;
+
+// ****************************************************************************
+// the heavy atoms of a molecule, numbered from 0, with each atom's neighbours
+// and the labels of the bonds to them. If labels_ is false, the bonds aren't
+// labelled and the atoms' hydrogens, charges and aromaticity are ignored.
+struct SkelGraph {
+  bool labels_;
+  vector<OEAtomBase *> atoms_;
+  vector<vector<pair<unsigned int,unsigned int> > > nbrs_;
+};
+
+// ****************************************************************************
+// Returns false if the molecule has isotopically labelled hydrogens, which
+// would be lost.
+static bool build_skel_graph( const OEMolBase &mol , bool bond_labels , SkelGraph &g ) {
+
+  g.labels_ = bond_labels;
+  vector<int> num( mol.GetMaxAtomIdx() , -1 );
+  for( OEIter<OEAtomBase> atom = mol.GetAtoms() ; atom ; ++atom ) {
+    if( OEElemNo::H == atom->GetAtomicNum() ) {
+      if( atom->GetIsotope() ) {
+        return false;
+      }
+      continue;
+    }
+    num[atom->GetIdx()] = static_cast<int>( g.atoms_.size() );
+    g.atoms_.push_back( atom );
+  }
+
+  g.nbrs_.resize( g.atoms_.size() );
+  for( OEIter<OEBondBase> bond = mol.GetBonds() ; bond ; ++bond ) {
+    int b = num[bond->GetBgn()->GetIdx()];
+    int e = num[bond->GetEnd()->GetIdx()];
+    if( b < 0 || e < 0 ) {
+      continue;
+    }
+    unsigned int label = 0;
+    if( bond_labels ) {
+      label = bond->IsAromatic() ? 4 : bond->GetOrder();
+    }
+    g.nbrs_[b].push_back( make_pair( static_cast<unsigned int>( e ) , label ) );
+    g.nbrs_[e].push_back( make_pair( static_cast<unsigned int>( b ) , label ) );
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+// the rank of each atom's invariant, as its colour.
+static void rank_invariants( const vector<vector<unsigned int> > &invs ,
+                             vector<unsigned int> &colours ) {
+
+  vector<pair<vector<unsigned int>,unsigned int> > sorted_invs;
+  for( size_t i = 0 , is = invs.size() ; i < is ; ++i ) {
+    sorted_invs.push_back( make_pair( invs[i] , static_cast<unsigned int>( i ) ) );
+  }
+  sort( sorted_invs.begin() , sorted_invs.end() );
+
+  colours = vector<unsigned int>( invs.size() , 0 );
+  unsigned int colour = 0;
+  for( size_t i = 0 , is = sorted_invs.size() ; i < is ; ++i ) {
+    if( i && sorted_invs[i].first != sorted_invs[i - 1].first ) {
+      ++colour;
+    }
+    colours[sorted_invs[i].second] = colour;
+  }
+
+}
+
+// ****************************************************************************
+static unsigned int num_colours( const vector<unsigned int> &colours ) {
+
+  return static_cast<unsigned int>( set<unsigned int>( colours.begin() , colours.end() ).size() );
+
+}
+
+// ****************************************************************************
+// Each atom's colour followed by those of its neighbours with the bond labels,
+// ranked to give the new colours, until there are no more of them. The old
+// colour comes first, so cells only ever split, and in an order that doesn't
+// depend on the atom numbering.
+static void refine_colours( const SkelGraph &g , vector<unsigned int> &colours ) {
+
+  unsigned int old_num = num_colours( colours );
+  while( true ) {
+    vector<vector<unsigned int> > invs( colours.size() );
+    for( size_t i = 0 , is = colours.size() ; i < is ; ++i ) {
+      vector<unsigned int> nbr_cols;
+      typedef pair<unsigned int,unsigned int> NBR;
+      BOOST_FOREACH( const NBR &nbr , g.nbrs_[i] ) {
+        nbr_cols.push_back( colours[nbr.first] * 8 + nbr.second );
+      }
+      sort( nbr_cols.begin() , nbr_cols.end() );
+      invs[i].push_back( colours[i] );
+      invs[i].insert( invs[i].end() , nbr_cols.begin() , nbr_cols.end() );
+    }
+    rank_invariants( invs , colours );
+    unsigned int new_num = num_colours( colours );
+    if( new_num == old_num ) {
+      break;
+    }
+    old_num = new_num;
+  }
+
+}
+
+// ****************************************************************************
+// What search_colourings has found so far. The first discrete colouring it
+// reaches is kept, along with the atoms singled out on the way to it. Any
+// later one that encodes the same is the same graph in a different order, and
+// so gives an automorphism, which is used to put the atoms into orbits at
+// each level of the path to the first one: the atoms that can be swapped by
+// the automorphisms found that leave the atoms singled out above that level
+// where they are. Singling out atoms in the same orbit gives the same keys,
+// so only one of them need be tried.
+struct ColouringSearch {
+  ColouringSearch() : num_leaves_( 0 ) {}
+  unsigned int num_leaves_;
+  string best_key_;
+  string first_key_;
+  vector<unsigned int> first_order_; // the atom at each position in the first leaf
+  vector<unsigned int> first_path_; // the atoms singled out to get there
+  vector<vector<unsigned int> > orbits_; // union-find, for each level of first_path_
+};
+
+// ****************************************************************************
+static unsigned int orbit_root( vector<unsigned int> &orbits , unsigned int i ) {
+
+  while( orbits[i] != i ) {
+    orbits[i] = orbits[orbits[i]];
+    i = orbits[i];
+  }
+  return i;
+
+}
+
+// ****************************************************************************
+// gamma maps each atom to its image. It's added to the orbits of every level
+// of the first path whose atoms above it are all fixed by it.
+static void add_automorphism( const vector<unsigned int> &gamma , ColouringSearch &cs ) {
+
+  for( size_t k = 0 , ks = cs.first_path_.size() ; k < ks ; ++k ) {
+    if( k && gamma[cs.first_path_[k - 1]] != cs.first_path_[k - 1] ) {
+      break;
+    }
+    vector<unsigned int> &orbits = cs.orbits_[k];
+    for( unsigned int i = 0 , is = static_cast<unsigned int>( gamma.size() ) ; i < is ; ++i ) {
+      unsigned int a = orbit_root( orbits , i );
+      unsigned int b = orbit_root( orbits , gamma[i] );
+      if( a != b ) {
+        orbits[max( a , b )] = min( a , b );
+      }
+    }
+  }
+
+}
+
+// ****************************************************************************
+static void append_uint( unsigned int val , string &key ) {
+
+  for( int i = 0 ; i < 4 ; ++i ) {
+    key += static_cast<char>( ( val >> ( 8 * i ) ) & 0xff );
+  }
+
+}
+
+// ****************************************************************************
+// the graph written out in colour order, which must be discrete. order is
+// the atom at each position.
+static void encode_graph( const SkelGraph &g , const vector<unsigned int> &colours ,
+                          vector<unsigned int> &order , string &key ) {
+
+  order = vector<unsigned int>( colours.size() , 0 );
+  for( size_t i = 0 , is = colours.size() ; i < is ; ++i ) {
+    order[colours[i]] = static_cast<unsigned int>( i );
+  }
+
+  key.clear();
+  BOOST_FOREACH( unsigned int i , order ) {
+    const OEAtomBase *atom = g.atoms_[i];
+    append_uint( atom->GetAtomicNum() , key );
+    append_uint( atom->GetIsotope() , key );
+    if( g.labels_ ) {
+      append_uint( static_cast<unsigned int>( atom->GetFormalCharge() + 128 ) , key );
+      append_uint( atom->GetTotalHCount() , key );
+      append_uint( atom->IsAromatic() , key );
+    }
+  }
+  BOOST_FOREACH( unsigned int i , order ) {
+    vector<pair<unsigned int,unsigned int> > bonds;
+    typedef pair<unsigned int,unsigned int> NBR;
+    BOOST_FOREACH( const NBR &nbr , g.nbrs_[i] ) {
+      if( colours[nbr.first] > colours[i] ) {
+        bonds.push_back( make_pair( colours[nbr.first] , nbr.second ) );
+      }
+    }
+    sort( bonds.begin() , bonds.end() );
+    append_uint( static_cast<unsigned int>( bonds.size() ) , key );
+    BOOST_FOREACH( const NBR &bond , bonds ) {
+      append_uint( bond.first , key );
+      append_uint( bond.second , key );
+    }
+  }
+
+}
+
+// ****************************************************************************
+// Refine colours, and if that leaves ties, single out each atom of the first
+// tied cell in turn and carry on. The smallest encoding of all the discrete
+// colourings found is the canonical one, unless there were too many to try.
+// path is the atoms singled out so far. On the first path, atoms in the same
+// orbit as one already tried are skipped. A discrete colouring that gives
+// an automorphism means everything below where its path left the first path
+// is the same as what's been done already, so the search goes straight back
+// there: the return value is the level to go back to, or -1 to carry on.
+static int search_colourings( const SkelGraph &g , vector<unsigned int> colours ,
+                              vector<unsigned int> &path , ColouringSearch &cs ) {
+
+  refine_colours( g , colours );
+
+  vector<unsigned int> cell_sizes( colours.size() , 0 );
+  BOOST_FOREACH( unsigned int c , colours ) {
+    ++cell_sizes[c];
+  }
+  unsigned int tied_colour = 0;
+  while( tied_colour < cell_sizes.size() && cell_sizes[tied_colour] < 2 ) {
+    ++tied_colour;
+  }
+  if( cell_sizes.size() == tied_colour ) {
+    ++cs.num_leaves_;
+    string key;
+    vector<unsigned int> order;
+    encode_graph( g , colours , order , key );
+    if( cs.first_key_.empty() ) {
+      cs.first_key_ = cs.best_key_ = key;
+      cs.first_order_ = order;
+      cs.first_path_ = path;
+      cs.orbits_.resize( path.size() );
+      BOOST_FOREACH( vector<unsigned int> &orbits , cs.orbits_ ) {
+        for( unsigned int i = 0 , is = static_cast<unsigned int>( colours.size() ) ; i < is ; ++i ) {
+          orbits.push_back( i );
+        }
+      }
+      return -1;
+    }
+    if( key == cs.first_key_ ) {
+      vector<unsigned int> gamma( order.size() , 0 );
+      for( size_t i = 0 , is = order.size() ; i < is ; ++i ) {
+        gamma[order[i]] = cs.first_order_[i];
+      }
+      add_automorphism( gamma , cs );
+      size_t div = 0;
+      while( div < path.size() && path[div] == cs.first_path_[div] ) {
+        ++div;
+      }
+      return static_cast<int>( div );
+    }
+    if( key < cs.best_key_ ) {
+      cs.best_key_ = key;
+    }
+    return -1;
+  }
+
+  int level = static_cast<int>( path.size() );
+  vector<unsigned int> tried;
+  for( size_t i = 0 , is = colours.size() ; i < is ; ++i ) {
+    if( colours[i] != tied_colour ) {
+      continue;
+    }
+    if( cs.num_leaves_ > MAX_LEAVES ) {
+      return -1;
+    }
+    // the orbits are only known once the first leaf's been found, so this
+    // has to be checked each time.
+    bool on_first_path = path.size() < cs.first_path_.size() &&
+        equal( path.begin() , path.end() , cs.first_path_.begin() );
+    if( on_first_path ) {
+      vector<unsigned int> &orbits = cs.orbits_[path.size()];
+      unsigned int root = orbit_root( orbits , static_cast<unsigned int>( i ) );
+      bool same_orbit = false;
+      BOOST_FOREACH( unsigned int t , tried ) {
+        if( orbit_root( orbits , t ) == root ) {
+          same_orbit = true;
+          break;
+        }
+      }
+      if( same_orbit ) {
+        continue;
+      }
+    }
+    vector<unsigned int> new_colours( colours.size() , 0 );
+    for( size_t j = 0 ; j < is ; ++j ) {
+      new_colours[j] = 2 * colours[j] + 1;
+    }
+    new_colours[i] = 2 * colours[i];
+    path.push_back( static_cast<unsigned int>( i ) );
+    int back_to = search_colourings( g , new_colours , path , cs );
+    path.pop_back();
+    tried.push_back( static_cast<unsigned int>( i ) );
+    if( back_to >= 0 && back_to < level ) {
+      return back_to;
+    }
+  }
+
+  return -1;
+
+}
+
+// ****************************************************************************
+// all the discrete colourings from colours, as above. Returns false if there
+// were too many of them to try.
+static bool canonical_colouring_key( const SkelGraph &g , const vector<unsigned int> &colours ,
+                                     string &key ) {
+
+  ColouringSearch cs;
+  vector<unsigned int> path;
+  search_colourings( g , colours , path , cs );
+  if( cs.num_leaves_ > MAX_LEAVES ) {
+    key.clear();
+    return false;
+  }
+  key = cs.best_key_;
+
+  return true;
+
+}
+
+// ****************************************************************************
+// The symmetry classes of the heavy atoms of mol from its connectivity alone,
+// on the atoms as generic data.
+void tag_skeleton_classes( OEMolBase &mol ) {
+
+  SkelGraph g;
+  if( !build_skel_graph( mol , false , g ) ) {
+    return;
+  }
+
+  vector<vector<unsigned int> > invs;
+  BOOST_FOREACH( OEAtomBase *atom , g.atoms_ ) {
+    invs.push_back( vector<unsigned int>() );
+    invs.back().push_back( atom->GetAtomicNum() );
+    invs.back().push_back( atom->GetIsotope() );
+    invs.back().push_back( atom->GetHvyDegree() );
+  }
+  vector<unsigned int> colours;
+  rank_invariants( invs , colours );
+  refine_colours( g , colours );
+
+  for( size_t i = 0 , is = g.atoms_.size() ; i < is ; ++i ) {
+    g.atoms_[i]->DeleteData( SKELETON_CLASS_TAG );
+    g.atoms_[i]->SetData<unsigned int>( SKELETON_CLASS_TAG , colours[i] );
+  }
+
+}
+
+// ****************************************************************************
+// mol must have had its aromaticity perceived, and have come from a molecule
+// that tag_skeleton_classes was used on. Returns false if there's no key,
+// because the tags are missing or there was too much symmetry.
+bool skeleton_canonical_key( const OEMolBase &mol , string &key ) {
+
+  key.clear();
+  SkelGraph g;
+  if( !build_skel_graph( mol , true , g ) ) {
+    return false;
+  }
+
+  vector<vector<unsigned int> > invs;
+  BOOST_FOREACH( OEAtomBase *atom , g.atoms_ ) {
+    if( !atom->HasData( SKELETON_CLASS_TAG ) ) {
+      return false;
+    }
+    invs.push_back( vector<unsigned int>() );
+    invs.back().push_back( atom->GetData<unsigned int>( SKELETON_CLASS_TAG ) );
+    invs.back().push_back( atom->GetTotalHCount() );
+    invs.back().push_back( static_cast<unsigned int>( atom->GetFormalCharge() + 128 ) );
+    invs.back().push_back( atom->IsAromatic() );
+  }
+  vector<unsigned int> colours;
+  rank_invariants( invs , colours );
+
+  return canonical_colouring_key( g , colours , key );
+
+}
+
+// ****************************************************************************
+// Returns false if there's no key, because there was too much symmetry.
+bool skeleton_connectivity_key( const OEMolBase &mol , string &key ) {
+
+  key.clear();
+  SkelGraph g;
+  if( !build_skel_graph( mol , false , g ) ) {
+    return false;
+  }
+
+  vector<vector<unsigned int> > invs;
+  BOOST_FOREACH( OEAtomBase *atom , g.atoms_ ) {
+    invs.push_back( vector<unsigned int>() );
+    invs.back().push_back( atom->GetAtomicNum() );
+    invs.back().push_back( atom->GetIsotope() );
+  }
+  vector<unsigned int> colours;
+  rank_invariants( invs , colours );
+
+  return canonical_colouring_key( g , colours , key );
+
+}
+
+} // EO namespace DACLIB
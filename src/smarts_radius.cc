@@ -0,0 +1,90 @@
+//
+// file smarts_radius.cc
+// agent
+// 18th October 2026
+//
+// Crude, text-based calculation of how far, in bonds, a SMARTS pattern can
+// see from any one of the atoms it matches. It's the number of atoms in the
+// pattern less 1, plus the largest radius of any recursive SMARTS in it, so
+// it's an over-estimate but never an under-estimate. If an atom further
+// than this from a match is changed, the match can't be affected.
+// Returns -1 if the pattern has more than one component, in which case
+// there's no limit.
+
+#include <algorithm>
+#include <string>
+
+using namespace std;
+
+namespace DACLIB {
+
+// *******************************************************************************
+// position of the bracket or parenthesis that closes the one at start
+size_t find_closing( const string &smarts , size_t start ) {
+
+  const char open = smarts[start];
+  const char close = '(' == open ? ')' : ']';
+  int depth = 0;
+  for( size_t i = start , is = smarts.length() ; i < is ; ++i ) {
+    if( open == smarts[i] ) {
+      ++depth;
+    } else if( close == smarts[i] ) {
+      --depth;
+      if( !depth ) {
+        return i;
+      }
+    }
+  }
+
+  return string::npos;
+
+}
+
+// *******************************************************************************
+int smarts_radius( const string &smarts ) {
+
+  int num_atoms = 0 , max_rec_rad = 0;
+  for( size_t i = 0 , is = smarts.length() ; i < is ; ++i ) {
+    switch( smarts[i] ) {
+    case '.' :
+      return -1;
+    case '[' : {
+      size_t j = find_closing( smarts , i );
+      if( string::npos == j ) {
+        return -1; // it's not going to parse anyway
+      }
+      ++num_atoms;
+      // recursive SMARTS inside the atom
+      for( size_t k = smarts.find( "$(" , i ) ; k < j ; k = smarts.find( "$(" , k + 1 ) ) {
+        size_t l = find_closing( smarts , k + 1 );
+        if( string::npos == l ) {
+          return -1;
+        }
+        int rec_rad = smarts_radius( smarts.substr( k + 2 , l - k - 2 ) );
+        if( -1 == rec_rad ) {
+          return -1;
+        }
+        max_rec_rad = max( max_rec_rad , rec_rad );
+        k = l;
+      }
+      i = j;
+      break;
+    }
+    case 'B' : case 'C' : case 'N' : case 'O' : case 'P' : case 'S' :
+    case 'F' : case 'I' : case 'A' : case 'a' : case '*' :
+    case 'b' : case 'c' : case 'n' : case 'o' : case 'p' : case 's' :
+      // Cl and Br are a single atom. The l and r aren't matched, so only need
+      // to be careful not to count them.
+      ++num_atoms;
+      break;
+    default :
+      // bonds, ring closures, branches
+      break;
+    }
+  }
+
+  return num_atoms ? num_atoms - 1 + max_rec_rad : 0;
+
+}
+
+} // EO namespace DACLIB
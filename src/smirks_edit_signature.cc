@@ -0,0 +1,115 @@
+//
+// file smirks_edit_signature.cc
+// agent
+// 18th October 2026
+//
+// What a SMIRKS does, boiled down to something that can be compared with
+// other SMIRKS: the heavy atom bonds whose symbol changes, as pairs of
+// reactant and product symbol, sorted, and the number of hydrogens that move
+// from one atom to another. An implicit bond is taken to be single. If one
+// SMIRKS undoes another, its signature is the other's with each pair the
+// other way round, so this can pair up the forward and reverse rules of a
+// set. It's a necessary condition, not a sufficient one.
+
+#include "SmartsGraph.H"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+namespace DACLIB {
+
+// ****************************************************************************
+static bool sig_hydrogen( const SmartsAtom &atom ) {
+
+  return "H" == atom.expr_ || "#1" == atom.expr_;
+
+}
+
+// ****************************************************************************
+// heavy atom bonds and the heavy atom each hydrogen is on, by map index.
+static bool sig_bonds( const vector<SmartsAtom> &atoms ,
+                       const vector<SmartsBond> &bonds ,
+                       map<pair<unsigned int,unsigned int>,char> &heavy_bonds ,
+                       map<unsigned int,unsigned int> &h_attach ) {
+
+  BOOST_FOREACH( const SmartsBond &bond , bonds ) {
+    const SmartsAtom &a = atoms[bond.a_];
+    const SmartsAtom &b = atoms[bond.b_];
+    if( !a.map_ || !b.map_ ) {
+      return false;
+    }
+    if( sig_hydrogen( a ) || sig_hydrogen( b ) ) {
+      if( sig_hydrogen( a ) && sig_hydrogen( b ) ) {
+        return false;
+      }
+      h_attach[sig_hydrogen( a ) ? a.map_ : b.map_] = sig_hydrogen( a ) ? b.map_ : a.map_;
+    } else {
+      heavy_bonds[make_pair( min( a.map_ , b.map_ ) , max( a.map_ , b.map_ ) )] =
+          ' ' == bond.bond_ ? '-' : bond.bond_;
+    }
+  }
+
+  return true;
+
+}
+
+// ****************************************************************************
+// Returns false if the SMIRKS can't be broken down.
+bool smirks_edit_signature( const string &smirks ,
+                            vector<pair<char,char> > &bond_changes ,
+                            unsigned int &num_h_moves ) {
+
+  bond_changes.clear();
+  num_h_moves = 0;
+
+  size_t arrow = smirks.find( ">>" );
+  if( string::npos == arrow ) {
+    return false;
+  }
+  vector<SmartsAtom> r_atoms , p_atoms;
+  vector<SmartsBond> r_bonds , p_bonds;
+  if( !parse_smarts_graph( smirks.substr( 0 , arrow ) , r_atoms , r_bonds ) ||
+      !parse_smarts_graph( smirks.substr( arrow + 2 ) , p_atoms , p_bonds ) ) {
+    return false;
+  }
+
+  map<pair<unsigned int,unsigned int>,char> r_heavy , p_heavy;
+  map<unsigned int,unsigned int> r_h , p_h;
+  if( !sig_bonds( r_atoms , r_bonds , r_heavy , r_h ) ||
+      !sig_bonds( p_atoms , p_bonds , p_heavy , p_h ) ) {
+    return false;
+  }
+
+  // a bond on one side only is made or broken, and shows as a space
+  typedef pair<pair<unsigned int,unsigned int>,char> MAP_BOND;
+  BOOST_FOREACH( const MAP_BOND &rb , r_heavy ) {
+    map<pair<unsigned int,unsigned int>,char>::iterator pb = p_heavy.find( rb.first );
+    char p_bond = p_heavy.end() == pb ? ' ' : pb->second;
+    if( p_bond != rb.second ) {
+      bond_changes.push_back( make_pair( rb.second , p_bond ) );
+    }
+  }
+  BOOST_FOREACH( const MAP_BOND &pb , p_heavy ) {
+    if( r_heavy.end() == r_heavy.find( pb.first ) ) {
+      bond_changes.push_back( make_pair( ' ' , pb.second ) );
+    }
+  }
+  sort( bond_changes.begin() , bond_changes.end() );
+
+  typedef pair<unsigned int,unsigned int> H_ATTACH;
+  BOOST_FOREACH( const H_ATTACH &rh , r_h ) {
+    map<unsigned int,unsigned int>::iterator ph = p_h.find( rh.first );
+    if( p_h.end() == ph || ph->second != rh.second ) {
+      ++num_h_moves;
+    }
+  }
+
+  return true;
+
+}
+
+} // EO namespace DACLIB
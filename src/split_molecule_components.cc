@@ -0,0 +1,43 @@
+//
+// file split_molecule_components.cc
+// agent
+// 18th October 2026
+//
+// Splits a molecule into its connected components, one new molecule each,
+// with the title of the original. The caller owns the new molecules. If
+// there's only one component, nothing is made and 1 is returned, so the
+// common case costs no more than the component perception.
+
+#include <oechem.h>
+
+#include <vector>
+
+using namespace std;
+using namespace OEChem;
+
+namespace DACLIB {
+
+// ****************************************************************************
+unsigned int split_molecule_components( const OEMolBase &mol ,
+                                        vector<OEMolBase *> &comps ) {
+
+  vector<unsigned int> parts( mol.GetMaxAtomIdx() , 0 );
+  unsigned int num_parts = OEDetermineComponents( mol , &parts[0] );
+  if( num_parts < 2 ) {
+    return num_parts;
+  }
+
+  OEPartPredAtom pred( &parts[0] );
+  for( unsigned int i = 1 ; i <= num_parts ; ++i ) {
+    pred.SelectPart( i );
+    OEMolBase *comp = OENewMolBase( OEMolBaseType::OEDefault );
+    OESubsetMol( *comp , mol , pred );
+    comp->SetTitle( mol.GetTitle() );
+    comps.push_back( comp );
+  }
+
+  return num_parts;
+
+}
+
+} // EO namespace DACLIB
@@ -22,6 +22,10 @@
 #include "TautEnumSettings.H"
 #include "TautStand.H"
 #include "FileExceptions.H"
+#include "GlobalDedup.H"
+#include "ProtonationCache.H"
+#include "RunSummary.H"
+#include "SmilesWriter.H"
 
 #include <iostream>
 #include <list>
@@ -30,6 +34,7 @@
 
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -63,6 +68,53 @@ void fix_output_smiles_format( oemolstreambase &oms ) {
 
 }
 
+// ****************************************************************************
+// null if it's not wanted
+GlobalDedup *create_global_dedup( const TautEnumSettings &tes ) {
+
+  if( !tes.global_dedup() ) {
+    return 0;
+  }
+  try {
+    return new GlobalDedup( tes.global_dedup_mapping_file() , tes.global_dedup_memory() ,
+                            tes.global_dedup_spill_dir() );
+  } catch( DACLIB::FileWriteOpenError &e ) {
+    cerr << e.what() << endl;
+    exit( 1 );
+  }
+
+}
+
+// ****************************************************************************
+// null if it's not wanted. The cached molecules would have the wrong SMIRKS
+// in their names, so not if they're going in.
+ProtonationCache *create_protonation_cache( const TautEnumSettings &tes ) {
+
+  if( !tes.enumerate_protonation() || !tes.protonation_cache_size() ||
+      tes.add_smirks_to_name() ) {
+    return 0;
+  }
+  return new ProtonationCache( tes.protonation_cache_size() );
+
+}
+
+// ****************************************************************************
+// null if the output file isn't SMILES, or the OEChem writer is wanted. The
+// output file is opened here in that case, so the oemolostream mustn't be.
+SmilesWriter *create_smiles_writer( const TautEnumSettings &tes ) {
+
+  if( tes.oechem_smiles_writer() || !SmilesWriter::handles( tes.output_mol_file() ) ) {
+    return 0;
+  }
+  try {
+    return new SmilesWriter( tes.output_mol_file() );
+  } catch( DACLIB::FileWriteOpenError &e ) {
+    cerr << e.what() << endl;
+    exit( 1 );
+  }
+
+}
+
 // ****************************************************************************
 void serial_run( const TautEnumSettings &tes ) {
 
@@ -74,18 +126,35 @@ void serial_run( const TautEnumSettings &tes ) {
     exit( 1 );
   }
 
+  boost::scoped_ptr<SmilesWriter> smiles_writer( create_smiles_writer( tes ) );
   oemolostream oms;
-  if( !oms.open( tes.output_mol_file() ) ) {
-    cerr << "Failed to open " << tes.output_mol_file() << " for writing." << endl;
-    exit( 1 );
+  if( !smiles_writer ) {
+    if( !oms.open( tes.output_mol_file() ) ) {
+      cerr << "Failed to open " << tes.output_mol_file() << " for writing." << endl;
+      exit( 1 );
+    }
+    fix_output_smiles_format( oms );
   }
 
-  fix_output_smiles_format( oms );
-
+  boost::scoped_ptr<GlobalDedup> global_dedup( create_global_dedup( tes ) );
+  boost::scoped_ptr<ProtonationCache> prot_cache( create_protonation_cache( tes ) );
   TautEnumCallableSerial tc( &ims , &oms , tes );
+  tc.set_global_dedup( global_dedup.get() );
+  tc.set_smiles_writer( smiles_writer.get() );
+  tc.set_protonation_cache( prot_cache.get() );
+  RunSummary run_summary;
+  tc.set_run_summary( &run_summary );
 
   tc();
 
+  run_summary.report( cerr );
+  if( prot_cache ) {
+    prot_cache->report( cerr );
+  }
+  if( global_dedup ) {
+    global_dedup->report( cerr );
+  }
+
 }
 
 // ****************************************************************************
@@ -102,9 +171,12 @@ void threaded_run( const TautEnumSettings &tes ) {
   oemolithread ims;
   ims.open( tes.input_mol_file() );
 
+  boost::scoped_ptr<SmilesWriter> smiles_writer( create_smiles_writer( tes ) );
   oemolothread oms;
-  oms.open( tes.output_mol_file() );
-  fix_output_smiles_format( oms );
+  if( !smiles_writer ) {
+    oms.open( tes.output_mol_file() );
+    fix_output_smiles_format( oms );
+  }
 
   // In OEToolkits 1.7.6, OEPerceiveChiral, which is used in TautEnum, gives a memory error
   // using the default memory pool system.  Either of these two fixes it, at the expense of
@@ -112,7 +184,14 @@ void threaded_run( const TautEnumSettings &tes ) {
   // OESystem::OESetMemPoolMode( OESystem::OEMemPoolMode::System );
   OESystem::OESetMemPoolMode(OESystem::OEMemPoolMode::Mutexed|OESystem::OEMemPoolMode::UnboundedCache);
 
+  boost::scoped_ptr<GlobalDedup> global_dedup( create_global_dedup( tes ) );
+  boost::scoped_ptr<ProtonationCache> prot_cache( create_protonation_cache( tes ) );
   TautEnumCallableThreaded tct( &ims , &oms , tes );
+  tct.set_global_dedup( global_dedup.get() );
+  tct.set_smiles_writer( smiles_writer.get() );
+  tct.set_protonation_cache( prot_cache.get() );
+  RunSummary run_summary;
+  tct.set_run_summary( &run_summary );
 
   // create the threads
   list<TautEnumCallableThreaded> callables;
@@ -133,6 +212,14 @@ void threaded_run( const TautEnumSettings &tes ) {
   tg.join_all(); // wait for them all to finish
   boost::this_thread::sleep( boost::posix_time::seconds( 1 ) ); // give worker threads time to deallocate
 
+  run_summary.report( cerr );
+  if( prot_cache ) {
+    prot_cache->report( cerr );
+  }
+  if( global_dedup ) {
+    global_dedup->report( cerr );
+  }
+
 }
 
 // ****************************************************************************
@@ -0,0 +1,272 @@
+//
+// file taut_index.cc
+// agent
+// 18th October 2026
+//
+// This is a standalone program for tautomer-aware registration lookups.
+// Building, it standardises and enumerates each molecule of a corpus of
+// registered compounds, as taut_enum would, and writes a TautIndex from the
+// canonical SMILES of every tautomer to the compound's name. Querying, it
+// does the same to each input molecule and looks its tautomers up in the
+// index, so finding the registered compounds that are tautomers of a new one
+// takes one hash probe per tautomer, rather than enumerating everything
+// again. The index must be queried with the same SMIRKS it was built with.
+// With --are-tautomers there's no index, and the input molecules are taken
+// in pairs, each pair being asked whether they're tautomers of each other.
+
+#include "TautEnum.H"
+#include "TautIndex.H"
+#include "TautIndexSettings.H"
+#include "TautStand.H"
+#include "FileExceptions.H"
+#include "chrono.h"
+#include "taut_enum_default_vector_bindings.H"
+#include "taut_enum_default_standardise_smirks.H"
+#include "taut_enum_default_enum_smirks_extended.H"
+#include "taut_enum_default_enum_smirks_orig.H"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+string create_cansmi( const OEMolBase &in_mol );
+void hash_smiles_128( const string &smiles , boost::uint64_t &hi ,
+                      boost::uint64_t &lo ); // in eponymous file
+}
+
+// in canned_tautenum_routines.cc
+void prepare_molecule( OEMolBase &mol );
+
+extern string BUILD_TIME; // in build_time.cc
+
+typedef boost::shared_ptr<TautStand> pTautStand;
+typedef boost::shared_ptr<TautEnum> pTautEnum;
+
+// ****************************************************************************
+void create_objects( const TautIndexSettings &tis ,
+                     pTautStand &taut_stand , pTautEnum &taut_enum ) {
+
+  try {
+    if( !tis.standardise_smirks_file().empty() ) {
+      taut_stand.reset( new TautStand( tis.standardise_smirks_file() , tis.vb_file() , true ) );
+    } else {
+      taut_stand.reset( new TautStand( DACLIB::STAND_SMIRKS , DACLIB::VBS ) );
+    }
+    if( !tis.enumerate_smirks_file().empty() ) {
+      taut_enum.reset( new TautEnum( tis.enumerate_smirks_file() , tis.vb_file() , true ,
+                                     tis.max_tautomers() ) );
+    } else {
+      const string &enum_smirks = tis.original_enumeration() ? DACLIB::ENUM_SMIRKS_ORIG : DACLIB::ENUM_SMIRKS_EXTENDED;
+      taut_enum.reset( new TautEnum( enum_smirks , DACLIB::VBS , tis.max_tautomers() ) );
+    }
+  } catch( DACLIB::FileReadOpenError &e ) {
+    cerr << e.what() << endl;
+    exit( 1 );
+  }
+  taut_enum->set_native_engine( tis.native_engine() );
+
+}
+
+// ****************************************************************************
+// the distinct canonical SMILES of the tautomers of mol. If there are too
+// many, it's just the standardised one, which will still find the compounds
+// that standardise to the same thing.
+void tautomer_smiles( OEMolBase &mol , TautStand &taut_stand , TautEnum &taut_enum ,
+                      vector<string> &smis ) {
+
+  prepare_molecule( mol );
+  OEMolBase *std_mol = taut_stand.standardise( mol );
+  try {
+    vector<OEMolBase *> taut_mols = taut_enum.enumerate( *std_mol );
+    BOOST_FOREACH( OEMolBase *taut_mol , taut_mols ) {
+      smis.push_back( DACLIB::create_cansmi( *taut_mol ) );
+      delete taut_mol;
+    }
+  } catch( TooManyOutMols &e ) {
+    cerr << "Maximum number of tautomers generated for " << mol.GetTitle()
+         << " so just using the standardised one." << endl;
+    smis.push_back( DACLIB::create_cansmi( *std_mol ) );
+  }
+  delete std_mol;
+
+  sort( smis.begin() , smis.end() );
+  smis.erase( unique( smis.begin() , smis.end() ) , smis.end() );
+
+}
+
+// ****************************************************************************
+void build_index( const TautIndexSettings &tis , oemolistream &ims ,
+                  TautStand &taut_stand , TautEnum &taut_enum ) {
+
+  vector<TautIndex::Entry> entries;
+  vector<string> ids;
+  OEGraphMol mol;
+  while( OEReadMolecule( ims , mol ) ) {
+    string id = mol.GetTitle();
+    if( id.empty() ) {
+      id = string( "Mol_" ) + boost::lexical_cast<string>( ids.size() + 1 );
+    }
+    vector<string> smis;
+    tautomer_smiles( mol , taut_stand , taut_enum , smis );
+    BOOST_FOREACH( const string &smi , smis ) {
+      TautIndex::Entry entry;
+      DACLIB::hash_smiles_128( smi , entry.hi_ , entry.lo_ );
+      entry.id_num_ = ids.size();
+      entries.push_back( entry );
+    }
+    ids.push_back( id );
+    mol.Clear();
+    if( !( ids.size() % 10000 ) ) {
+      cerr << "Done " << ids.size() << " molecules, " << entries.size() << " tautomers." << endl;
+    }
+  }
+
+  try {
+    TautIndex::write( tis.index_file() , entries , ids );
+  } catch( DACLIB::FileWriteOpenError &e ) {
+    cerr << e.what() << endl;
+    exit( 1 );
+  }
+  cerr << "Wrote index of " << entries.size() << " tautomers of " << ids.size()
+       << " molecules to " << tis.index_file() << "." << endl;
+
+}
+
+// ****************************************************************************
+// writes the name of each query molecule followed by the IDs of the indexed
+// compounds that are tautomers of it, or NO_MATCH.
+void query_index( const TautIndexSettings &tis , oemolistream &ims ,
+                  TautStand &taut_stand , TautEnum &taut_enum , ostream &os ) {
+
+  TautIndex *taut_index = 0;
+  try {
+    taut_index = new TautIndex( tis.index_file() );
+  } catch( DACLIB::FileReadOpenError &e ) {
+    cerr << e.what() << endl;
+    exit( 1 );
+  }
+  cerr << "Index has " << taut_index->num_entries() << " tautomers of "
+       << taut_index->num_ids() << " molecules." << endl;
+
+  Chronograph cg;
+  unsigned int num_queries = 0;
+  OEGraphMol mol;
+  while( OEReadMolecule( ims , mol ) ) {
+    ++num_queries;
+    string title = mol.GetTitle();
+    vector<string> smis , ids;
+    tautomer_smiles( mol , taut_stand , taut_enum , smis );
+    BOOST_FOREACH( const string &smi , smis ) {
+      taut_index->lookup( smi , ids );
+    }
+    os << title;
+    if( ids.empty() ) {
+      os << " NO_MATCH";
+    }
+    BOOST_FOREACH( const string &id , ids ) {
+      os << " " << id;
+    }
+    os << endl;
+    mol.Clear();
+  }
+  double time_taken = cg.stop();
+  cerr << "Looked up " << num_queries << " molecules in " << time_taken << "s." << endl;
+
+  delete taut_index;
+
+}
+
+// ****************************************************************************
+// writes the names of each pair of molecules followed by YES if they're
+// tautomers, NO if not, and TOO_MANY if it couldn't be decided.
+void compare_pairs( oemolistream &ims , TautStand &taut_stand , TautEnum &taut_enum ,
+                    ostream &os ) {
+
+  Chronograph cg;
+  unsigned int num_pairs = 0;
+  OEGraphMol mol_a , mol_b;
+  while( OEReadMolecule( ims , mol_a ) ) {
+    if( !OEReadMolecule( ims , mol_b ) ) {
+      cerr << "Odd number of molecules, so " << mol_a.GetTitle() << " has no partner." << endl;
+      break;
+    }
+    ++num_pairs;
+    prepare_molecule( mol_a );
+    prepare_molecule( mol_b );
+    OEMolBase *std_mol_a = taut_stand.standardise( mol_a );
+    OEMolBase *std_mol_b = taut_stand.standardise( mol_b );
+    os << mol_a.GetTitle() << " " << mol_b.GetTitle();
+    try {
+      os << ( taut_enum.are_tautomers( *std_mol_a , *std_mol_b ) ? " YES" : " NO" ) << endl;
+    } catch( TooManyOutMols &e ) {
+      os << " TOO_MANY" << endl;
+    }
+    delete std_mol_a;
+    delete std_mol_b;
+    mol_a.Clear();
+    mol_b.Clear();
+  }
+  double time_taken = cg.stop();
+  cerr << "Compared " << num_pairs << " pairs of molecules in " << time_taken << "s." << endl;
+
+}
+
+// ****************************************************************************
+int main( int argc , char **argv ) {
+
+  cerr << endl << "taut_index, built " << BUILD_TIME << " using OEToolkits version "
+       << OEChem::OEChemGetRelease() << " (" << OEChem::OEChemGetVersion() << ")." << endl;
+
+  TautIndexSettings tis( argc , argv );
+
+  if( !tis ) {
+    tis.print_error( cout );
+    tis.print_error( cerr );
+    tis.print_usage( cout );
+    exit( 1 );
+  }
+
+  OESystem::OEThrow.SetLevel( OESystem::OEErrorLevel::Error );
+
+  oemolistream ims;
+  if( !ims.open( tis.input_mol_file() ) ) {
+    cerr << "Failed to open " << tis.input_mol_file() << " for reading." << endl;
+    exit( 1 );
+  }
+
+  pTautStand taut_stand;
+  pTautEnum taut_enum;
+  create_objects( tis , taut_stand , taut_enum );
+
+  if( !tis.query() && !tis.are_tautomers() ) {
+    build_index( tis , ims , *taut_stand , *taut_enum );
+    return 0;
+  }
+
+  ofstream ofs;
+  if( !tis.output_file().empty() ) {
+    ofs.open( tis.output_file().c_str() );
+    if( !ofs || !ofs.good() ) {
+      cerr << "Failed to open " << tis.output_file() << " for writing." << endl;
+      exit( 1 );
+    }
+  }
+  if( tis.are_tautomers() ) {
+    compare_pairs( ims , *taut_stand , *taut_enum , tis.output_file().empty() ? cout : ofs );
+  } else {
+    query_index( tis , ims , *taut_stand , *taut_enum ,
+                 tis.output_file().empty() ? cout : ofs );
+  }
+
+}
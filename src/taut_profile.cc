@@ -0,0 +1,450 @@
+//
+// file taut_profile.cc
+// agent
+// 18th October 2026
+//
+// This is a standalone program that runs a corpus of molecules through the
+// standardisation and enumeration SMIRKS, as taut_enum would, keeping track
+// of what each SMIRKS did. From that, it writes out new SMIRKS files without
+// the standardisation SMIRKS that never changed anything and the enumeration
+// SMIRKS that never made a tautomer, or only made tautomers that other
+// SMIRKS also made from the same parent. The remaining enumeration SMIRKS
+// are put in order of how much they did. It then runs the corpus again with
+// the new SMIRKS, and reports the time taken by each set and any molecules
+// for which the results are different. The new SMIRKS are intended for
+// screening large numbers of molecules, where speed matters more than
+// covering every last case, and should be profiled with a corpus that
+// resembles what they'll be used on.
+// The order of the standardisation SMIRKS matters, so it isn't changed, and
+// no attempt is made to find standardisation SMIRKS that others make
+// unnecessary.
+
+#include "TautEnum.H"
+#include "TautProfileSettings.H"
+#include "TautStand.H"
+#include "FileExceptions.H"
+#include "chrono.h"
+#include "taut_enum_default_vector_bindings.H"
+#include "taut_enum_default_standardise_smirks.H"
+#include "taut_enum_default_enum_smirks_extended.H"
+#include "taut_enum_default_enum_smirks_orig.H"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <oechem.h>
+
+#include <boost/foreach.hpp>
+#include <boost/ref.hpp>
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+using namespace OEChem;
+using namespace OESystem;
+
+namespace DACLIB {
+string create_cansmi( const OEMolBase &in_mol );
+}
+
+// in canned_tautenum_routines.cc
+void prepare_molecule( OEMolBase &mol );
+
+extern string BUILD_TIME; // in build_time.cc
+
+typedef boost::shared_ptr<TautStand> pTautStand;
+typedef boost::shared_ptr<TautEnum> pTautEnum;
+typedef pair<string,string> Transform;
+
+// ****************************************************************************
+// What each enumeration SMIRKS did. A transformation is the canonical SMILES
+// of the tautomer the SMIRKS was applied to, and of the product.
+class EnumTrace {
+
+public :
+
+  explicit EnumTrace( size_t num_smirks ) :
+    num_products_( num_smirks , 0 ) , transforms_( num_smirks ) {}
+
+  void operator()( unsigned int smirks_num , const string &parent_smi ,
+                   const string &prod_smi ) {
+    ++num_products_[smirks_num];
+    transforms_[smirks_num].insert( make_pair( parent_smi , prod_smi ) );
+  }
+
+  vector<unsigned int> num_products_;
+  vector<set<Transform> > transforms_;
+
+};
+
+// ****************************************************************************
+void read_corpus( const string &mol_file , vector<pair<string,string> > &corpus ) {
+
+  oemolistream ims;
+  if( !ims.open( mol_file ) ) {
+    cerr << "Failed to open " << mol_file << " for reading." << endl;
+    exit( 1 );
+  }
+
+  OEGraphMol mol;
+  while( OEReadMolecule( ims , mol ) ) {
+    string smi;
+    OECreateSmiString( smi , mol , OESMILESFlag::ISOMERIC );
+    corpus.push_back( make_pair( smi , string( mol.GetTitle() ) ) );
+    mol.Clear();
+  }
+
+}
+
+// ****************************************************************************
+// the objects as specified in tps, or with the built-in SMIRKS.
+void create_full_objects( const TautProfileSettings &tps ,
+                          pTautStand &taut_stand , pTautEnum &taut_enum ) {
+
+  try {
+    if( !tps.standardise_smirks_file().empty() ) {
+      taut_stand.reset( new TautStand( tps.standardise_smirks_file() , tps.vb_file() , true ) );
+    } else {
+      taut_stand.reset( new TautStand( DACLIB::STAND_SMIRKS , DACLIB::VBS ) );
+    }
+    if( !tps.enumerate_smirks_file().empty() ) {
+      taut_enum.reset( new TautEnum( tps.enumerate_smirks_file() , tps.vb_file() , true ,
+                                     tps.max_tautomers() ) );
+    } else {
+      const string &enum_smirks = tps.extended_enumeration() ? DACLIB::ENUM_SMIRKS_EXTENDED : DACLIB::ENUM_SMIRKS_ORIG;
+      taut_enum.reset( new TautEnum( enum_smirks , DACLIB::VBS , tps.max_tautomers() ) );
+    }
+  } catch( DACLIB::FileReadOpenError &e ) {
+    cerr << e.what() << endl;
+    exit( 1 );
+  }
+
+}
+
+// ****************************************************************************
+void set_up_objects( const TautProfileSettings &tps , TautEnum &taut_enum ) {
+
+  taut_enum.set_native_engine( tps.native_engine() );
+
+}
+
+// ****************************************************************************
+// standardise and enumerate each molecule in the corpus, putting the sorted
+// canonical SMILES of the tautomers into results. Returns the time taken.
+double run_corpus( const vector<pair<string,string> > &corpus ,
+                   TautStand &taut_stand , TautEnum &taut_enum ,
+                   vector<vector<string> > &results ) {
+
+  Chronograph cg;
+  OEGraphMol mol;
+  for( size_t i = 0 , is = corpus.size() ; i < is ; ++i ) {
+    mol.Clear();
+    OEParseSmiles( mol , corpus[i].first );
+    mol.SetTitle( corpus[i].second );
+    prepare_molecule( mol );
+    OEMolBase *std_mol = taut_stand.standardise( mol );
+    vector<string> tauts;
+    try {
+      vector<OEMolBase *> taut_mols = taut_enum.enumerate( *std_mol );
+      BOOST_FOREACH( OEMolBase *taut_mol , taut_mols ) {
+        tauts.push_back( DACLIB::create_cansmi( *taut_mol ) );
+        delete taut_mol;
+      }
+    } catch( TooManyOutMols &e ) {
+      tauts.push_back( string( "__MAX_TAUTS__ " ) + DACLIB::create_cansmi( *std_mol ) );
+    }
+    delete std_mol;
+    sort( tauts.begin() , tauts.end() );
+    results.push_back( tauts );
+  }
+
+  return cg.stop();
+
+}
+
+// ****************************************************************************
+void write_smirks( const vector<pair<string,string> > &smirks ,
+                   const vector<size_t> &to_write , ostream &os ) {
+
+  BOOST_FOREACH( size_t i , to_write ) {
+    os << smirks[i].second << " " << smirks[i].first << endl;
+  }
+
+}
+
+// ****************************************************************************
+void write_smirks_file( const string &filename , const string &corpus_file ,
+                        const vector<pair<string,string> > &smirks ,
+                        const vector<size_t> &to_write ) {
+
+  if( filename.empty() ) {
+    return;
+  }
+  ofstream ofs( filename.c_str() );
+  if( !ofs || !ofs.good() ) {
+    cerr << "Failed to open " << filename << " for writing." << endl;
+    exit( 1 );
+  }
+  ofs << "# " << to_write.size() << " of " << smirks.size()
+      << " SMIRKS, chosen by taut_profile using " << corpus_file << endl;
+  write_smirks( smirks , to_write , ofs );
+
+}
+
+// ****************************************************************************
+void write_vbs( const vector<pair<string,string> > &vbs , ostream &os ) {
+
+  for( size_t i = 0 , is = vbs.size() ; i < is ; ++i ) {
+    os << vbs[i].first << " " << vbs[i].second << endl;
+  }
+
+}
+
+// ****************************************************************************
+// The standardisation SMIRKS that changed something, in their original order.
+void prune_stand_smirks( const TautStand &taut_stand , vector<size_t> &kept ,
+                         vector<string> &drop_reasons ) {
+
+  const vector<unsigned int> &fire_counts = taut_stand.fire_counts();
+  drop_reasons = vector<string>( fire_counts.size() );
+  for( size_t i = 0 , is = fire_counts.size() ; i < is ; ++i ) {
+    if( fire_counts[i] ) {
+      kept.push_back( i );
+    } else {
+      drop_reasons[i] = "never fired";
+    }
+  }
+
+}
+
+// ****************************************************************************
+// The enumeration SMIRKS that made a transformation that no other kept SMIRKS
+// made. The ones that made fewest are considered for dropping first, as they're
+// most likely to be specialised versions of another. The rest are put in
+// descending order of the number of transformations they made.
+void prune_enum_smirks( const TautEnum &taut_enum , const EnumTrace &trace ,
+                        vector<size_t> &kept , vector<string> &drop_reasons ) {
+
+  const vector<pair<string,string> > &smirks = taut_enum.smirks();
+  const vector<set<Transform> > &transforms = trace.transforms_;
+
+  vector<pair<size_t,size_t> > by_size;
+  map<Transform,unsigned int> num_makers;
+  for( size_t i = 0 , is = transforms.size() ; i < is ; ++i ) {
+    by_size.push_back( make_pair( transforms[i].size() , i ) );
+    BOOST_FOREACH( const Transform &t , transforms[i] ) {
+      ++num_makers[t];
+    }
+  }
+  sort( by_size.begin() , by_size.end() );
+
+  drop_reasons = vector<string>( transforms.size() );
+  vector<char> dropped( transforms.size() , 0 );
+  for( size_t i = 0 , is = by_size.size() ; i < is ; ++i ) {
+    size_t sn = by_size[i].second;
+    if( transforms[sn].empty() ) {
+      dropped[sn] = 1;
+      drop_reasons[sn] = "never fired";
+      continue;
+    }
+    bool made_elsewhere = true;
+    BOOST_FOREACH( const Transform &t , transforms[sn] ) {
+      if( num_makers[t] < 2 ) {
+        made_elsewhere = false;
+        break;
+      }
+    }
+    if( made_elsewhere ) {
+      dropped[sn] = 1;
+      BOOST_FOREACH( const Transform &t , transforms[sn] ) {
+        --num_makers[t];
+      }
+    }
+  }
+
+  // say which of the kept SMIRKS made the dropped ones unnecessary
+  for( size_t i = 0 , is = transforms.size() ; i < is ; ++i ) {
+    if( !dropped[i] || transforms[i].empty() ) {
+      continue;
+    }
+    drop_reasons[i] = "subsumed by";
+    for( size_t j = 0 , js = transforms.size() ; j < js ; ++j ) {
+      if( dropped[j] ) {
+        continue;
+      }
+      BOOST_FOREACH( const Transform &t , transforms[i] ) {
+        if( transforms[j].count( t ) ) {
+          drop_reasons[i] += string( " " ) + smirks[j].first;
+          break;
+        }
+      }
+    }
+  }
+
+  for( size_t i = by_size.size() ; i > 0 ; --i ) {
+    if( !dropped[by_size[i-1].second] ) {
+      kept.push_back( by_size[i-1].second );
+    }
+  }
+
+}
+
+// ****************************************************************************
+void report_smirks( const string &label , const vector<pair<string,string> > &smirks ,
+                    const vector<unsigned int> &num_fires ,
+                    const vector<unsigned int> *num_transforms ,
+                    const vector<size_t> &kept , const vector<string> &drop_reasons ,
+                    ostream &os ) {
+
+  os << label << " SMIRKS : kept " << kept.size() << " of " << smirks.size() << endl;
+  for( size_t i = 0 , is = smirks.size() ; i < is ; ++i ) {
+    os << "  " << smirks[i].first << " : fired " << num_fires[i] << " times";
+    if( num_transforms ) {
+      os << ", " << (*num_transforms)[i] << " different transformations";
+    }
+    if( !drop_reasons[i].empty() ) {
+      os << " : DROPPED, " << drop_reasons[i];
+    }
+    os << endl;
+  }
+  os << endl;
+
+}
+
+// ****************************************************************************
+void report_changes( const vector<pair<string,string> > &corpus ,
+                     const vector<vector<string> > &full_results ,
+                     const vector<vector<string> > &pruned_results ,
+                     ostream &os ) {
+
+  unsigned int num_changed = 0;
+  ostringstream oss;
+  for( size_t i = 0 , is = corpus.size() ; i < is ; ++i ) {
+    if( full_results[i] == pruned_results[i] ) {
+      continue;
+    }
+    ++num_changed;
+    oss << "  " << corpus[i].second << " : " << corpus[i].first << " : "
+        << full_results[i].size() << " tautomers with the full SMIRKS, "
+        << pruned_results[i].size() << " with the pruned ones." << endl;
+    vector<string> lost , gained;
+    set_difference( full_results[i].begin() , full_results[i].end() ,
+                    pruned_results[i].begin() , pruned_results[i].end() ,
+                    back_inserter( lost ) );
+    set_difference( pruned_results[i].begin() , pruned_results[i].end() ,
+                    full_results[i].begin() , full_results[i].end() ,
+                    back_inserter( gained ) );
+    BOOST_FOREACH( const string &smi , lost ) {
+      oss << "    lost   " << smi << endl;
+    }
+    BOOST_FOREACH( const string &smi , gained ) {
+      oss << "    gained " << smi << endl;
+    }
+  }
+
+  os << "Molecules whose output changes : " << num_changed << " of "
+     << corpus.size() << endl << oss.str();
+
+}
+
+// ****************************************************************************
+int main( int argc , char **argv ) {
+
+  cerr << endl << "taut_profile, built " << BUILD_TIME << " using OEToolkits version "
+       << OEChem::OEChemGetRelease() << " (" << OEChem::OEChemGetVersion() << ")." << endl;
+
+  TautProfileSettings tps( argc , argv );
+
+  if( !tps ) {
+    tps.print_error( cout );
+    tps.print_error( cerr );
+    tps.print_usage( cout );
+    exit( 1 );
+  }
+
+  OESystem::OEThrow.SetLevel( OESystem::OEErrorLevel::Error );
+
+  vector<pair<string,string> > corpus;
+  read_corpus( tps.input_mol_file() , corpus );
+  cerr << "Profiling SMIRKS with " << corpus.size() << " molecules." << endl;
+
+  // the tracing slows things down, so the time for the full SMIRKS comes
+  // from a separate run without it.
+  pTautStand taut_stand;
+  pTautEnum taut_enum;
+  create_full_objects( tps , taut_stand , taut_enum );
+  set_up_objects( tps , *taut_enum );
+  EnumTrace trace( taut_enum->smirks().size() );
+  taut_enum->set_product_tracer( boost::ref( trace ) );
+  vector<vector<string> > full_results;
+  run_corpus( corpus , *taut_stand , *taut_enum , full_results );
+
+  vector<size_t> stand_kept , enum_kept;
+  vector<string> stand_drop_reasons , enum_drop_reasons;
+  prune_stand_smirks( *taut_stand , stand_kept , stand_drop_reasons );
+  prune_enum_smirks( *taut_enum , trace , enum_kept , enum_drop_reasons );
+
+  pTautStand full_stand , pruned_stand;
+  pTautEnum full_enum , pruned_enum;
+  create_full_objects( tps , full_stand , full_enum );
+  set_up_objects( tps , *full_enum );
+  full_results.clear();
+  double full_time = run_corpus( corpus , *full_stand , *full_enum , full_results );
+
+  // the same vector bindings do for both sets
+  ostringstream vbs_oss , stand_oss , enum_oss;
+  write_vbs( taut_enum->vector_bindings() , vbs_oss );
+  write_smirks( taut_stand->smirks() , stand_kept , stand_oss );
+  write_smirks( taut_enum->smirks() , enum_kept , enum_oss );
+  pruned_stand.reset( new TautStand( stand_oss.str() , vbs_oss.str() ) );
+  pruned_enum.reset( new TautEnum( enum_oss.str() , vbs_oss.str() , tps.max_tautomers() ) );
+  set_up_objects( tps , *pruned_enum );
+  vector<vector<string> > pruned_results;
+  double pruned_time = run_corpus( corpus , *pruned_stand , *pruned_enum , pruned_results );
+
+  write_smirks_file( tps.output_standardise_smirks_file() , tps.input_mol_file() ,
+                     taut_stand->smirks() , stand_kept );
+  write_smirks_file( tps.output_enumerate_smirks_file() , tps.input_mol_file() ,
+                     taut_enum->smirks() , enum_kept );
+  if( !tps.output_vb_file().empty() ) {
+    ofstream ofs( tps.output_vb_file().c_str() );
+    if( !ofs || !ofs.good() ) {
+      cerr << "Failed to open " << tps.output_vb_file() << " for writing." << endl;
+      exit( 1 );
+    }
+    write_vbs( taut_enum->vector_bindings() , ofs );
+  }
+
+  ofstream report_ofs;
+  if( !tps.report_file().empty() ) {
+    report_ofs.open( tps.report_file().c_str() );
+    if( !report_ofs || !report_ofs.good() ) {
+      cerr << "Failed to open " << tps.report_file() << " for writing." << endl;
+      exit( 1 );
+    }
+  }
+  ostream &os = tps.report_file().empty() ? cout : report_ofs;
+
+  os << "Corpus : " << tps.input_mol_file() << " with " << corpus.size()
+     << " molecules." << endl << endl;
+  vector<unsigned int> num_transforms;
+  BOOST_FOREACH( const set<Transform> &t , trace.transforms_ ) {
+    num_transforms.push_back( static_cast<unsigned int>( t.size() ) );
+  }
+  report_smirks( "Standardisation" , taut_stand->smirks() , taut_stand->fire_counts() ,
+                 0 , stand_kept , stand_drop_reasons , os );
+  report_smirks( "Enumeration" , taut_enum->smirks() , trace.num_products_ ,
+                 &num_transforms , enum_kept , enum_drop_reasons , os );
+
+  os << "Time with full SMIRKS   : " << full_time << "s" << endl
+     << "Time with pruned SMIRKS : " << pruned_time << "s" << endl;
+  if( pruned_time > 0.0 ) {
+    os << "Speed-up : " << full_time / pruned_time << endl;
+  }
+  os << endl;
+  report_changes( corpus , full_results , pruned_results , os );
+
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Differential test of the native SMIRKS engine against OELibraryGen: the same
+# enumeration is done both ways and the sorted outputs should be identical.
+# The outcome is added to compare_engines.log, with the date and the number
+# of tautomers each engine made.
+
+TAUT_ENUM=../src/exe_DEBUG/taut_enum
+LOG=compare_engines.log
+
+echo "compare_engines.sh run on $(date)" >> ${LOG}
+for enum in original extended ; do
+    ${TAUT_ENUM} -I chembl_20_first_10000.smi -O chembl_libgen_${enum}.smi --${enum}-enumeration
+    ${TAUT_ENUM} -I chembl_20_first_10000.smi -O chembl_native_${enum}.smi --${enum}-enumeration --native-engine
+    sort chembl_libgen_${enum}.smi > chembl_libgen_${enum}_sorted.smi
+    sort chembl_native_${enum}.smi > chembl_native_${enum}_sorted.smi
+    num_libgen=$(wc -l < chembl_libgen_${enum}_sorted.smi)
+    num_native=$(wc -l < chembl_native_${enum}_sorted.smi)
+    if diff -q chembl_libgen_${enum}_sorted.smi chembl_native_${enum}_sorted.smi > /dev/null ; then
+        echo "${enum} enumeration : engines agree, ${num_libgen} tautomers" | tee -a ${LOG}
+    else
+        echo "${enum} enumeration : engines DIFFER, ${num_libgen} from OELibraryGen, ${num_native} native" | tee -a ${LOG}
+        diff chembl_libgen_${enum}_sorted.smi chembl_native_${enum}_sorted.smi | head -20 | tee -a ${LOG}
+    fi
+done
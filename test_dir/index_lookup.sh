@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Index the ChEMBL sample, then look up the standardised versions of the
+# same molecules, which should all be found.
+
+TAUT_INDEX=../src/exe_DEBUG/taut_index
+
+${TAUT_INDEX} -I chembl_20_first_10000.smi --index-file chembl.tidx
+${TAUT_INDEX} -I chembl_20_first_10000_std.smi --index-file chembl.tidx \
+    --query -O chembl_lookup.txt
+echo "Not found : $(grep -c NO_MATCH chembl_lookup.txt)"
+
+# The same again, a pair at a time, each molecule with its standardised
+# version, without the index. They should all be tautomers.
+paste -d '\n' chembl_20_first_10000.smi chembl_20_first_10000_std.smi > chembl_pairs.smi
+${TAUT_INDEX} -I chembl_pairs.smi --are-tautomers -O chembl_pairs.txt
+echo "Not tautomers : $(grep -c ' NO$' chembl_pairs.txt)"
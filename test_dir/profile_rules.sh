@@ -0,0 +1,13 @@
+#!/bin/bash
+
+# Find the enumeration SMIRKS that matter for the ChEMBL sample, and check
+# that the pruned set gives the same tautomers.
+
+TAUT_PROFILE=../src/exe_DEBUG/taut_profile
+
+${TAUT_PROFILE} -I chembl_20_first_10000.smi --extended-enumeration \
+    --output-standardise-smirks-file chembl_stand.smirks \
+    --output-enumerate-smirks-file chembl_enum.smirks \
+    --output-vector-bindings-file chembl.vb \
+    --report-file chembl_profile.txt
+grep -E "^(Standardisation|Enumeration) SMIRKS|^Time|^Speed-up|^Molecules whose" chembl_profile.txt